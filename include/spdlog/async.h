@@ -24,14 +24,10 @@
 
 namespace spdlog {
 
-namespace details {
-static const size_t default_async_q_size = 8192;
-}
-
 // async logger factory - creates async loggers backed with thread pool.
 // if a global thread pool doesn't already exist, create it with default queue
-// size of 8192 items and single thread.
-template<async_overflow_policy OverflowPolicy = async_overflow_policy::block>
+// size of 8192 items (or per thread lanes of 1024 items) and single thread.
+template<async_overflow_policy OverflowPolicy = async_overflow_policy::block, async_queue_mode QueueMode = async_queue_mode::shared_queue>
 struct async_factory_impl
 {
     template<typename Sink, typename... SinkArgs>
@@ -46,7 +42,9 @@ struct async_factory_impl
         auto tp = registry_inst.get_tp();
         if (tp == nullptr)
         {
-            tp = std::make_shared<details::thread_pool>(details::default_async_q_size, 1U);
+            thread_pool_options options;
+            options.queue_mode = QueueMode;
+            tp = std::make_shared<details::thread_pool>(options);
             registry_inst.set_tp(tp);
         }
 
@@ -73,6 +71,12 @@ inline std::shared_ptr<spdlog::logger> create_async_nb(std::string logger_name,
 }
 
 // set global thread pool.
+inline void init_thread_pool(const thread_pool_options &options)
+{
+    auto tp = std::make_shared<details::thread_pool>(options);
+    details::registry::instance().set_tp(std::move(tp));
+}
+
 inline void init_thread_pool(
     size_t q_size, size_t thread_count, std::function<void()> on_thread_start, std::function<void()> on_thread_stop)
 {
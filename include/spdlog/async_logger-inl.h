@@ -10,6 +10,7 @@
 #include <spdlog/sinks/sink.h>
 #include <spdlog/details/thread_pool.h>
 
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -23,51 +24,273 @@ SPDLOG_INLINE spdlog::async_logger::async_logger(
     : async_logger(std::move(logger_name), {std::move(single_sink)}, std::move(tp), overflow_policy)
 {}
 
-// send the log message to the thread pool
-SPDLOG_INLINE void spdlog::async_logger::sink_it_(const details::log_msg &msg){
-    SPDLOG_TRY{if (auto pool_ptr = thread_pool_.lock()){pool_ptr->post_log(shared_from_this(), msg, overflow_policy_);
+SPDLOG_INLINE spdlog::async_logger::async_logger(const async_logger &other)
+    : std::enable_shared_from_this<async_logger>()
+    , logger(other)
+    , thread_pool_(other.thread_pool_)
+    , overflow_policy_(other.overflow_policy_)
+{
+    register_();
+    shard_.store(other.shard(), std::memory_order_relaxed);
+    set_overflow_timeout(other.overflow_timeout());
 }
-else
+
+SPDLOG_INLINE spdlog::async_logger::~async_logger()
 {
-    throw_spdlog_ex("async log: thread pool doesn't exist anymore");
+    if (!pool_exit_ || !posted_.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    SPDLOG_TRY
+    {
+        if (auto pool_ptr = thread_pool_.lock())
+        {
+            pool_ptr->drain();
+        }
+        else
+        {
+            // the pool is shutting down, and its workers still might be processing our messages
+            std::unique_lock<std::mutex> lock(pool_exit_->mutex);
+            pool_exit_->cv.wait(lock, [this] { return pool_exit_->done; });
+        }
+    }
+    SPDLOG_CATCH_STD
 }
+
+SPDLOG_INLINE void spdlog::async_logger::register_()
+{
+    if (auto pool_ptr = thread_pool_.lock())
+    {
+        pool_exit_ = pool_ptr->exit_state();
+        defer_formatting_ = pool_ptr->deferred_formatting();
+        shard_.store(std::hash<std::string>()(name_) % pool_ptr->shards_n(), std::memory_order_relaxed);
+    }
 }
-SPDLOG_LOGGER_CATCH(msg.source)
+
+SPDLOG_INLINE void spdlog::async_logger::set_shard(size_t shard)
+{
+    shard_.store(shard, std::memory_order_relaxed);
+}
+
+SPDLOG_INLINE size_t spdlog::async_logger::shard() const
+{
+    return shard_.load(std::memory_order_relaxed);
+}
+
+SPDLOG_INLINE void spdlog::async_logger::set_overflow_timeout(std::chrono::microseconds timeout)
+{
+    overflow_timeout_.store(timeout.count(), std::memory_order_relaxed);
+}
+
+SPDLOG_INLINE std::chrono::microseconds spdlog::async_logger::overflow_timeout() const
+{
+    return std::chrono::microseconds(overflow_timeout_.load(std::memory_order_relaxed));
+}
+
+SPDLOG_INLINE size_t spdlog::async_logger::overrun_counter() const
+{
+    return overrun_counter_.load(std::memory_order_relaxed);
+}
+
+SPDLOG_INLINE void spdlog::async_logger::reset_overrun_counter()
+{
+    overrun_counter_.store(0, std::memory_order_relaxed);
+}
+
+SPDLOG_INLINE size_t spdlog::async_logger::drop_counter() const
+{
+    return drop_counter_.load(std::memory_order_relaxed);
+}
+
+SPDLOG_INLINE void spdlog::async_logger::reset_drop_counter()
+{
+    drop_counter_.store(0, std::memory_order_relaxed);
+}
+
+// send the log message to the thread pool
+SPDLOG_INLINE void spdlog::async_logger::sink_it_(const details::log_msg &msg)
+{
+    post_log_(msg, nullptr);
+}
+
+// send the serialized arguments to the thread pool, to be formatted there
+SPDLOG_INLINE void spdlog::async_logger::sink_deferred_(const details::log_msg &msg, details::deferred_format_fn format_fn)
+{
+    post_log_(msg, format_fn);
+}
+
+SPDLOG_INLINE void spdlog::async_logger::post_log_(const details::log_msg &msg, details::deferred_format_fn format_fn)
+{
+    SPDLOG_TRY
+    {
+        if (auto pool_ptr = thread_pool_.lock())
+        {
+            if (pool_exit_)
+            {
+                mark_posted_();
+                pool_ptr->post_log(this, msg, overflow_policy_, format_fn);
+            }
+            else
+            {
+                pool_ptr->post_log(shared_from_this(), msg, overflow_policy_, format_fn);
+            }
+        }
+        else
+        {
+            throw_spdlog_ex("async log: thread pool doesn't exist anymore");
+        }
+    }
+    SPDLOG_LOGGER_CATCH(msg.source)
 }
 
 // send flush request to the thread pool
-SPDLOG_INLINE void spdlog::async_logger::flush_(){
-    SPDLOG_TRY{if (auto pool_ptr = thread_pool_.lock()){pool_ptr->post_flush(shared_from_this(), overflow_policy_);
+SPDLOG_INLINE void spdlog::async_logger::flush_()
+{
+    request_flush_(nullptr);
 }
-else
+
+SPDLOG_INLINE std::future<void> spdlog::async_logger::flush_async()
 {
-    throw_spdlog_ex("async flush: thread pool doesn't exist anymore");
+    std::promise<void> waiter;
+    auto future = waiter.get_future();
+    request_flush_(&waiter);
+    return future;
 }
+
+// post a flush message, or merge into the one already queued.
+// the waiters of a request that could not be posted are released right away.
+SPDLOG_INLINE void spdlog::async_logger::request_flush_(std::promise<void> *waiter)
+{
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex_);
+        if (flush_queued_)
+        {
+            flush_merged_ = true;
+            if (waiter)
+            {
+                merged_waiters_.push_back(std::move(*waiter));
+            }
+            return;
+        }
+        flush_queued_ = true;
+        if (waiter)
+        {
+            flush_waiters_.push_back(std::move(*waiter));
+        }
+    }
+
+    bool posted = false;
+    SPDLOG_TRY
+    {
+        if (auto pool_ptr = thread_pool_.lock())
+        {
+            if (pool_exit_)
+            {
+                mark_posted_();
+                posted = pool_ptr->post_flush(this, overflow_policy_);
+            }
+            else
+            {
+                posted = pool_ptr->post_flush(shared_from_this(), overflow_policy_);
+            }
+        }
+        else
+        {
+            throw_spdlog_ex("async flush: thread pool doesn't exist anymore");
+        }
+    }
+    SPDLOG_LOGGER_CATCH(source_loc())
+
+    if (!posted)
+    {
+        backend_flush_request_(true);
+    }
 }
-SPDLOG_LOGGER_CATCH(source_loc())
+
+// raw_ptr mode: remember that the pool must be drained before this logger goes away.
+// check first, so the flag's cache line is not written on every message.
+SPDLOG_INLINE void spdlog::async_logger::mark_posted_()
+{
+    if (!posted_.load(std::memory_order_relaxed))
+    {
+        posted_.store(true, std::memory_order_relaxed);
+    }
 }
 
 //
 // backend functions - called from the thread pool to do the actual job
 //
 SPDLOG_INLINE void spdlog::async_logger::backend_sink_it_(const details::log_msg &msg)
+{
+    backend_sink_batch_(&msg, 1);
+}
+
+// hand the batch to each sink at once (sinks skip messages below their level),
+// then flush once if any message in the batch requires it.
+SPDLOG_INLINE void spdlog::async_logger::backend_sink_batch_(const details::log_msg *msgs, size_t count)
 {
     for (auto &sink : sinks_)
     {
-        if (sink->should_log(msg.level))
+        SPDLOG_TRY
+        {
+            sink->log_batch(msgs, count);
+        }
+        SPDLOG_LOGGER_CATCH(msgs[0].source)
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (should_flush_(msgs[i]))
+        {
+            backend_flush_();
+            break;
+        }
+    }
+}
+
+SPDLOG_INLINE void spdlog::async_logger::backend_format_(details::async_msg &msg, memory_buf_t &buf)
+{
+    SPDLOG_TRY
+    {
+        msg.format_payload(buf);
+    }
+    SPDLOG_LOGGER_CATCH(msg.source)
+}
+
+SPDLOG_INLINE bool spdlog::async_logger::backend_flush_request_(bool discard)
+{
+    std::vector<std::promise<void>> covered;
+    bool merged;
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex_);
+        covered.swap(flush_waiters_);
+        merged = flush_merged_ && !discard;
+        if (merged)
         {
-            SPDLOG_TRY
+            // the merged requests become the queued one, flushed by the worker later
+            flush_waiters_.swap(merged_waiters_);
+        }
+        else
+        {
+            for (auto &waiter : merged_waiters_)
             {
-                sink->log(msg);
+                covered.push_back(std::move(waiter));
             }
-            SPDLOG_LOGGER_CATCH(msg.source)
+            merged_waiters_.clear();
+            flush_queued_ = false;
         }
+        flush_merged_ = false;
     }
 
-    if (should_flush_(msg))
+    if (!discard)
     {
         backend_flush_();
     }
+    for (auto &waiter : covered)
+    {
+        waiter.set_value();
+    }
+    return merged;
 }
 
 SPDLOG_INLINE void spdlog::async_logger::backend_flush_()
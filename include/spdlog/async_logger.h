@@ -16,19 +16,34 @@
 
 #include <spdlog/logger.h>
 
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <vector>
+
 namespace spdlog {
 
 // Async overflow policy - block by default.
 enum class async_overflow_policy
 {
-    block,         // Block until message can be enqueued
-    overrun_oldest // Discard oldest message in the queue if full when trying to
-                   // add new item.
+    block,          // Block until message can be enqueued
+    overrun_oldest, // Discard oldest message in the queue if full when trying to
+                    // add new item.
+    discard_new,    // Discard the new message if the queue is full.
+    block_for       // Block until message can be enqueued, but at most for the
+                    // logger's overflow timeout. Then discard the new message.
 };
 
+namespace details {
+static const std::chrono::microseconds default_async_overflow_timeout{1000};
+} // namespace details
+
 namespace details {
 class thread_pool;
-}
+struct thread_pool_exit;
+struct async_msg;
+} // namespace details
 
 class SPDLOG_API async_logger final : public std::enable_shared_from_this<async_logger>, public logger
 {
@@ -41,7 +56,9 @@ public:
         : logger(std::move(logger_name), begin, end)
         , thread_pool_(std::move(tp))
         , overflow_policy_(overflow_policy)
-    {}
+    {
+        register_();
+    }
 
     async_logger(std::string logger_name, sinks_init_list sinks_list, std::weak_ptr<details::thread_pool> tp,
         async_overflow_policy overflow_policy = async_overflow_policy::block);
@@ -49,17 +66,72 @@ public:
     async_logger(std::string logger_name, sink_ptr single_sink, std::weak_ptr<details::thread_pool> tp,
         async_overflow_policy overflow_policy = async_overflow_policy::block);
 
+    async_logger(const async_logger &other);
+
+    // if the thread pool's messages refer to their logger by raw pointer,
+    // wait for the messages of this logger to be processed.
+    ~async_logger() override;
+
     std::shared_ptr<logger> clone(std::string new_name) override;
 
+    // flush in the background. the future gets ready once the sinks were flushed after the messages
+    // logged before the call (or the flush request was dropped, e.g. by thread_pool::shutdown()).
+    std::future<void> flush_async();
+
+    // shard of the thread pool this logger posts to (async_queue_mode::sharded).
+    // defaults to the hash of the logger's name. should be set before logging.
+    void set_shard(size_t shard);
+    size_t shard() const;
+
+    // how long async_overflow_policy::block_for waits for room in the queue
+    void set_overflow_timeout(std::chrono::microseconds timeout);
+    std::chrono::microseconds overflow_timeout() const;
+
+    // messages of this logger lost to overrun_oldest: discarded to make room for newer messages (maybe of
+    // other loggers), or in thread_lanes mode, discarded because the lane was full.
+    size_t overrun_counter() const;
+    void reset_overrun_counter();
+
+    // messages of this logger dropped by discard_new or block_for
+    size_t drop_counter() const;
+    void reset_drop_counter();
+
 protected:
     void sink_it_(const details::log_msg &msg) override;
+    void sink_deferred_(const details::log_msg &msg, details::deferred_format_fn format_fn) override;
     void flush_() override;
     void backend_sink_it_(const details::log_msg &incoming_log_msg);
+    void backend_sink_batch_(const details::log_msg *msgs, size_t count);
     void backend_flush_();
+    void backend_format_(details::async_msg &msg, memory_buf_t &buf);
+    // handle a flush message (flush unless discard is set, and release the waiters it covers).
+    // return true if flush requests were merged into it meanwhile: the worker must flush again
+    // once it caught up with the messages logged before them.
+    bool backend_flush_request_(bool discard);
 
 private:
     std::weak_ptr<details::thread_pool> thread_pool_;
     async_overflow_policy overflow_policy_;
+    // set if the thread pool is in async_logger_ref::raw_ptr mode
+    std::shared_ptr<details::thread_pool_exit> pool_exit_;
+    std::atomic<bool> posted_{false};
+    std::atomic<size_t> shard_{0};
+    std::atomic<std::chrono::microseconds::rep> overflow_timeout_{details::default_async_overflow_timeout.count()};
+    std::atomic<size_t> overrun_counter_{0};
+    std::atomic<size_t> drop_counter_{0};
+
+    // flush requests are coalesced: while a flush message is queued, further requests are merged
+    // into it instead of posting another one.
+    std::mutex flush_mutex_;
+    bool flush_queued_ = false;
+    bool flush_merged_ = false;
+    std::vector<std::promise<void>> flush_waiters_;  // covered by the queued flush message
+    std::vector<std::promise<void>> merged_waiters_; // of the merged requests
+
+    void register_();
+    void mark_posted_();
+    void post_log_(const details::log_msg &msg, details::deferred_format_fn format_fn);
+    void request_flush_(std::promise<void> *waiter);
 };
 } // namespace spdlog
 
@@ -0,0 +1,312 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#ifndef SPDLOG_HEADER_ONLY
+#    include <spdlog/binary_decoder.h>
+#endif
+
+#include <spdlog/details/binary_format.h>
+#include <spdlog/details/deferred_format.h>
+#include <spdlog/fmt/args.h>
+#include <spdlog/pattern_formatter.h>
+
+#include <chrono>
+#include <cstring>
+
+namespace spdlog {
+
+namespace details {
+namespace binary {
+inline void check_available(const char *p, const char *end, size_t n)
+{
+    if (static_cast<size_t>(end - p) < n)
+    {
+        throw_spdlog_ex("binary_decoder: truncated arguments");
+    }
+}
+
+template<typename T>
+inline T read_arg(const char *&p, const char *end)
+{
+    check_available(p, end, sizeof(T));
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return value;
+}
+
+// only the bytes of false or true: reading anything else as a bool is undefined
+inline bool read_bool(const char *&p, const char *end)
+{
+    check_available(p, end, sizeof(bool));
+    const bool values[] = {false, true};
+    for (bool value : values)
+    {
+        if (std::memcmp(p, &value, sizeof(bool)) == 0)
+        {
+            p += sizeof(bool);
+            return value;
+        }
+    }
+    throw_spdlog_ex("binary_decoder: malformed bool argument");
+}
+} // namespace binary
+} // namespace details
+
+SPDLOG_INLINE binary_decoder::binary_decoder(std::istream &in)
+    : in_(in)
+    , formatter_(details::make_unique<pattern_formatter>())
+{}
+
+SPDLOG_INLINE void binary_decoder::set_formatter(std::unique_ptr<formatter> f)
+{
+    formatter_ = std::move(f);
+}
+
+SPDLOG_INLINE void binary_decoder::set_pattern(std::string pattern, pattern_time_type time_type)
+{
+    formatter_ = details::make_unique<pattern_formatter>(std::move(pattern), time_type);
+}
+
+SPDLOG_INLINE bool binary_decoder::read(details::log_msg &msg)
+{
+    using details::binary::record_type;
+    for (;;)
+    {
+        unsigned char type;
+        if (!read_bytes_(&type, 1, true))
+        {
+            return false;
+        }
+
+        if (type == static_cast<unsigned char>(details::binary::magic[0]))
+        {
+            read_header_();
+        }
+        else if (type == static_cast<unsigned char>(record_type::logger))
+        {
+            auto id = read_<uint32_t>();
+            loggers_[id] = read_string_();
+        }
+        else if (type == static_cast<unsigned char>(record_type::format))
+        {
+            auto id = read_<uint32_t>();
+            format_entry entry;
+            entry.line = read_<int32_t>();
+            entry.filename = read_string_();
+            entry.funcname = read_string_();
+            entry.fmt = read_string_();
+            formats_[id] = std::move(entry);
+        }
+        else if (type == static_cast<unsigned char>(record_type::message))
+        {
+            auto lvl = read_<uint8_t>();
+            auto format_id = read_<uint32_t>();
+            auto logger_id = read_<uint32_t>();
+            auto time = read_<int64_t>();
+            auto thread_id = read_<uint64_t>();
+            auto args_size = read_<uint32_t>();
+            args_.resize(args_size);
+            read_bytes_(args_.data(), args_size);
+
+            auto format_it = formats_.find(format_id);
+            auto logger_it = loggers_.find(logger_id);
+            if (format_it == formats_.end() || logger_it == loggers_.end() || lvl >= level::n_levels)
+            {
+                throw_spdlog_ex("binary_decoder: malformed message record");
+            }
+            auto &entry = format_it->second;
+            payload_.clear();
+            format_args_(entry.fmt);
+
+            msg = details::log_msg{};
+            msg.logger_name = logger_it->second;
+            msg.level = static_cast<level::level_enum>(lvl);
+            msg.time = log_clock::time_point(std::chrono::duration_cast<log_clock::duration>(std::chrono::nanoseconds(time)));
+            msg.thread_id = static_cast<size_t>(thread_id);
+            if (entry.line != 0)
+            {
+                msg.source = source_loc{entry.filename.c_str(), entry.line, entry.funcname.c_str()};
+            }
+            msg.payload = string_view_t(payload_.data(), payload_.size());
+            return true;
+        }
+        else
+        {
+            throw_spdlog_ex("binary_decoder: unknown record type " + std::to_string(type));
+        }
+    }
+}
+
+SPDLOG_INLINE bool binary_decoder::next(memory_buf_t &dest)
+{
+    details::log_msg msg;
+    if (!read(msg))
+    {
+        return false;
+    }
+    formatter_->format(msg, dest);
+    return true;
+}
+
+SPDLOG_INLINE bool binary_decoder::read_bytes_(void *dest, size_t n, bool record_start)
+{
+    in_.read(static_cast<char *>(dest), static_cast<std::streamsize>(n));
+    auto got = static_cast<size_t>(in_.gcount());
+    if (got == n)
+    {
+        return true;
+    }
+    if (got == 0 && record_start)
+    {
+        return false;
+    }
+    throw_spdlog_ex("binary_decoder: truncated record");
+}
+
+template<typename T>
+SPDLOG_INLINE T binary_decoder::read_()
+{
+    T value;
+    read_bytes_(&value, sizeof(T));
+    return value;
+}
+
+SPDLOG_INLINE std::string binary_decoder::read_string_()
+{
+    std::string str(read_<uint32_t>(), '\0');
+    if (!str.empty())
+    {
+        read_bytes_(&str[0], str.size());
+    }
+    return str;
+}
+
+// the header starts a new dictionary (the magic's first byte was read already)
+SPDLOG_INLINE void binary_decoder::read_header_()
+{
+    char header[details::binary::header_size - 1];
+    read_bytes_(header, sizeof(header));
+    const char *sizes = header + sizeof(details::binary::magic) - 1;
+    uint16_t byte_order_mark;
+    std::memcpy(&byte_order_mark, sizes + 4, sizeof(byte_order_mark));
+    if (std::memcmp(header, details::binary::magic + 1, sizeof(details::binary::magic) - 1) != 0)
+    {
+        throw_spdlog_ex("binary_decoder: not a binary log");
+    }
+    if (static_cast<size_t>(sizes[0]) != sizeof(size_t) || static_cast<size_t>(sizes[1]) != sizeof(long) ||
+        static_cast<size_t>(sizes[2]) != sizeof(long double) || static_cast<size_t>(sizes[3]) != sizeof(void *) ||
+        byte_order_mark != details::binary::byte_order_mark)
+    {
+        throw_spdlog_ex("binary_decoder: the log was written on an incompatible platform");
+    }
+    loggers_.clear();
+    formats_.clear();
+}
+
+// format the serialized arguments in args_ into payload_
+SPDLOG_INLINE void binary_decoder::format_args_(string_view_t fmt)
+{
+    using details::binary::read_arg;
+    using details::deferred::arg_type;
+    const char *p = args_.data();
+    const char *end = p + args_.size();
+    details::binary::check_available(p, end, 1);
+    auto count = static_cast<size_t>(static_cast<unsigned char>(*p++));
+    details::binary::check_available(p, end, count);
+    const char *types = p;
+    p += count;
+
+    fmt::dynamic_format_arg_store<fmt::format_context> store;
+    store.reserve(count, 0);
+    for (size_t i = 0; i < count; i++)
+    {
+        switch (static_cast<arg_type>(types[i]))
+        {
+        case arg_type::bool_type:
+            store.push_back(details::binary::read_bool(p, end));
+            break;
+        case arg_type::char_type:
+            store.push_back(read_arg<char>(p, end));
+            break;
+        case arg_type::schar_type:
+            store.push_back(read_arg<signed char>(p, end));
+            break;
+        case arg_type::uchar_type:
+            store.push_back(read_arg<unsigned char>(p, end));
+            break;
+        case arg_type::short_type:
+            store.push_back(read_arg<short>(p, end));
+            break;
+        case arg_type::ushort_type:
+            store.push_back(read_arg<unsigned short>(p, end));
+            break;
+        case arg_type::int_type:
+            store.push_back(read_arg<int>(p, end));
+            break;
+        case arg_type::uint_type:
+            store.push_back(read_arg<unsigned int>(p, end));
+            break;
+        case arg_type::long_type:
+            store.push_back(read_arg<long>(p, end));
+            break;
+        case arg_type::ulong_type:
+            store.push_back(read_arg<unsigned long>(p, end));
+            break;
+        case arg_type::long_long_type:
+            store.push_back(read_arg<long long>(p, end));
+            break;
+        case arg_type::ulong_long_type:
+            store.push_back(read_arg<unsigned long long>(p, end));
+            break;
+#if defined(__SIZEOF_INT128__) && FMT_USE_INT128
+        case arg_type::int128_type:
+            store.push_back(read_arg<__int128_t>(p, end));
+            break;
+        case arg_type::uint128_type:
+            store.push_back(read_arg<__uint128_t>(p, end));
+            break;
+#endif
+        case arg_type::float_type:
+            store.push_back(read_arg<float>(p, end));
+            break;
+        case arg_type::double_type:
+            store.push_back(read_arg<double>(p, end));
+            break;
+        case arg_type::long_double_type:
+            store.push_back(read_arg<long double>(p, end));
+            break;
+        case arg_type::pointer_type:
+            store.push_back(read_arg<const void *>(p, end));
+            break;
+        case arg_type::null_pointer_type:
+            read_arg<std::nullptr_t>(p, end);
+            store.push_back(static_cast<const void *>(nullptr));
+            break;
+        case arg_type::string_type: {
+            auto size = read_arg<size_t>(p, end);
+            details::binary::check_available(p, end, size);
+            store.push_back(string_view_t(p, size));
+            p += size;
+            break;
+        }
+        default:
+            throw_spdlog_ex("binary_decoder: unsupported argument type " + std::to_string(static_cast<int>(static_cast<unsigned char>(types[i]))));
+        }
+    }
+    // a format string that does not match its arguments is corrupt input too
+    SPDLOG_TRY
+    {
+        fmt::vformat_to(fmt::appender(payload_), fmt, store);
+    }
+#ifndef SPDLOG_NO_EXCEPTIONS
+    catch (const fmt::format_error &ex)
+    {
+        throw_spdlog_ex(std::string("binary_decoder: ") + ex.what());
+    }
+#endif
+}
+
+} // namespace spdlog
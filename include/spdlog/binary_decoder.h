@@ -0,0 +1,87 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// Reads the files written by sinks::binary_file_sink, and formats their messages
+// as a text sink with the same pattern would have:
+//
+//     std::ifstream in("logs/app.bin", std::ios::binary);
+//     spdlog::binary_decoder decoder(in);
+//     decoder.set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%n] [%l] %v");
+//     memory_buf_t line;
+//     while (decoder.next(line))
+//     {
+//         std::fwrite(line.data(), 1, line.size(), stdout);
+//         line.clear();
+//     }
+//
+// The file must have been written on a platform with the same byte order and type sizes.
+// Flags that don't come from the message (e.g. %P, the process id) show the values of the decoding process.
+
+#ifdef SPDLOG_USE_STD_FORMAT
+#    error binary_decoder is not supported with SPDLOG_USE_STD_FORMAT
+#endif
+
+#include <spdlog/common.h>
+#include <spdlog/details/log_msg.h>
+#include <spdlog/formatter.h>
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace spdlog {
+
+class SPDLOG_API binary_decoder
+{
+public:
+    // formats with the default pattern, like a sink
+    explicit binary_decoder(std::istream &in);
+
+    binary_decoder(const binary_decoder &) = delete;
+    binary_decoder &operator=(const binary_decoder &) = delete;
+
+    void set_formatter(std::unique_ptr<formatter> f);
+    void set_pattern(std::string pattern, pattern_time_type time_type = pattern_time_type::local);
+
+    // read the next message, with its arguments formatted into the payload.
+    // its strings are valid until the next call.
+    // return false at the end of the input. throw spdlog_ex if it is malformed.
+    bool read(details::log_msg &msg);
+
+    // read the next message and append it to dest, formatted by the formatter.
+    bool next(memory_buf_t &dest);
+
+private:
+    struct format_entry
+    {
+        std::string fmt;
+        std::string filename;
+        std::string funcname;
+        int line;
+    };
+
+    std::istream &in_;
+    std::unique_ptr<formatter> formatter_;
+    std::unordered_map<uint32_t, std::string> loggers_;
+    std::unordered_map<uint32_t, format_entry> formats_;
+    memory_buf_t args_;
+    memory_buf_t payload_;
+
+    // false at the end of the input. throw if it ends within a record.
+    bool read_bytes_(void *dest, size_t n, bool record_start = false);
+    template<typename T>
+    T read_();
+    std::string read_string_();
+    void read_header_();
+    void format_args_(string_view_t fmt);
+};
+
+} // namespace spdlog
+
+#ifdef SPDLOG_HEADER_ONLY
+#    include "binary_decoder-inl.h"
+#endif
@@ -8,6 +8,7 @@
 
 #include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <initializer_list>
 #include <memory>
 #include <exception>
@@ -325,6 +326,8 @@ struct source_loc
     const char *filename{nullptr};
     int line{0};
     const char *funcname{nullptr};
+    // id of the details::callsite of the SPDLOG_LOGGER_CALL(..) the location comes from, 0 if none
+    uint32_t callsite_id{0};
 };
 
 struct file_event_handlers
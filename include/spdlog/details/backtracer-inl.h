@@ -6,35 +6,71 @@
 #ifndef SPDLOG_HEADER_ONLY
 #    include <spdlog/details/backtracer.h>
 #endif
+
+#include <algorithm>
+
 namespace spdlog {
 namespace details {
+// copies the stored messages into a single ring, to be taken over by the first thread logging to the copy
 SPDLOG_INLINE backtracer::backtracer(const backtracer &other)
 {
     std::lock_guard<std::mutex> lock(other.mutex_);
     enabled_ = other.enabled();
-    messages_ = other.messages_;
+    size_ = other.size_;
+    if (other.id_.load(std::memory_order_relaxed) == 0)
+    {
+        return;
+    }
+
+    std::vector<slot *> claimed;
+    claim_guard guard{claimed, 0};
+    claim_(other.rings_, other.size_, claimed);
+    auto copy = std::make_shared<ring>(size_);
+    for (auto *s : claimed)
+    {
+        store_(*copy, s->msg, s->format_fn);
+    }
+    copy->closed.store(true, std::memory_order_relaxed);
+    rings_.push_back(std::move(copy));
+    id_.store(next_id_(), std::memory_order_relaxed);
 }
 
 SPDLOG_INLINE backtracer::backtracer(backtracer &&other) SPDLOG_NOEXCEPT
 {
     std::lock_guard<std::mutex> lock(other.mutex_);
     enabled_ = other.enabled();
-    messages_ = std::move(other.messages_);
+    size_ = other.size_;
+    rings_ = std::move(other.rings_);
+    // threads keep using their rings
+    id_.store(other.id_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    other.id_.store(0, std::memory_order_relaxed);
 }
 
 SPDLOG_INLINE backtracer &backtracer::operator=(backtracer other)
 {
     std::lock_guard<std::mutex> lock(mutex_);
     enabled_ = other.enabled();
-    messages_ = std::move(other.messages_);
+    orphan_rings_();
+    size_ = other.size_;
+    rings_ = std::move(other.rings_);
+    id_.store(other.id_.load(std::memory_order_relaxed), std::memory_order_release);
+    other.id_.store(0, std::memory_order_relaxed);
     return *this;
 }
 
+SPDLOG_INLINE backtracer::~backtracer()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    orphan_rings_();
+}
+
 SPDLOG_INLINE void backtracer::enable(size_t size)
 {
     std::lock_guard<std::mutex> lock{mutex_};
     enabled_.store(true, std::memory_order_relaxed);
-    messages_ = circular_q<log_msg_buffer>{size};
+    orphan_rings_();
+    size_ = size;
+    id_.store(size > 0 ? next_id_() : 0, std::memory_order_release);
 }
 
 SPDLOG_INLINE void backtracer::disable()
@@ -50,26 +86,235 @@ SPDLOG_INLINE bool backtracer::enabled() const
 
 SPDLOG_INLINE void backtracer::push_back(const log_msg &msg)
 {
+    push_back(msg, nullptr);
+}
+
+SPDLOG_INLINE void backtracer::push_back(const log_msg &msg, deferred_format_fn format_fn)
+{
+#ifdef SPDLOG_NO_TLS
     std::lock_guard<std::mutex> lock{mutex_};
-    messages_.push_back(log_msg_buffer{msg});
+    if (size_ == 0)
+    {
+        return;
+    }
+    if (rings_.empty())
+    {
+        rings_.push_back(std::make_shared<ring>(size_));
+    }
+    store_(*rings_.front(), msg, format_fn);
+#else
+    ring *r = local_ring_();
+    if (r != nullptr)
+    {
+        store_(*r, msg, format_fn);
+    }
+#endif
 }
 
 SPDLOG_INLINE bool backtracer::empty() const
 {
     std::lock_guard<std::mutex> lock{mutex_};
-    return messages_.empty();
+    for (auto &r : rings_)
+    {
+        for (auto &s : r->slots)
+        {
+            if (s.state.load(std::memory_order_relaxed) == ready_slot)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
 }
 
 // pop all items in the q and apply the given fun on each of them.
 SPDLOG_INLINE void backtracer::foreach_pop(std::function<void(const details::log_msg &)> fun)
 {
     std::lock_guard<std::mutex> lock{mutex_};
-    while (!messages_.empty())
+    std::vector<slot *> claimed;
+    claim_guard guard{claimed, 0};
+    claim_(rings_, size_, claimed);
+    log_msg_buffer popped;
+    memory_buf_t formatted;
+    while (guard.next < claimed.size())
+    {
+        // popped first: the slot is free for its thread while the message is formatted and sunk
+        slot &s = *claimed[guard.next];
+        popped.assign(s.msg);
+        auto format_fn = s.format_fn;
+        guard.next++;
+        s.state.store(free_slot, std::memory_order_release);
+        if (format_fn == nullptr)
+        {
+            fun(popped);
+            continue;
+        }
+        formatted.clear();
+        format_fn(popped.payload, formatted);
+        log_msg msg(popped);
+        msg.payload = string_view_t(formatted.data(), formatted.size());
+        fun(msg);
+    }
+}
+
+SPDLOG_INLINE backtracer::claim_guard::~claim_guard()
+{
+    for (size_t i = next; i < claimed.size(); i++)
+    {
+        claimed[i]->state.store(ready_slot, std::memory_order_release);
+    }
+}
+
+SPDLOG_INLINE size_t backtracer::next_id_()
+{
+    static std::atomic<size_t> id_counter{0};
+    return ++id_counter;
+}
+
+// overwrite the ring's oldest message. called by the ring's thread only.
+SPDLOG_INLINE void backtracer::store_(ring &r, const log_msg &msg, deferred_format_fn format_fn)
+{
+    auto &s = r.slots[static_cast<size_t>(r.head % r.slots.size())];
+    auto state = s.state.load(std::memory_order_relaxed);
+    // the slot is being dumped: drop the message
+    if (state == reading_slot || !s.state.compare_exchange_strong(state, writing_slot, std::memory_order_acquire, std::memory_order_relaxed))
+    {
+        return;
+    }
+    s.msg.assign(msg);
+    s.format_fn = format_fn;
+    s.seq = r.head++;
+    s.state.store(ready_slot, std::memory_order_release);
+}
+
+// called under mutex_
+SPDLOG_INLINE void backtracer::orphan_rings_()
+{
+    for (auto &r : rings_)
+    {
+        r->orphaned.store(true, std::memory_order_relaxed);
+    }
+    rings_.clear();
+    id_.store(0, std::memory_order_relaxed);
+}
+
+SPDLOG_INLINE void backtracer::claim_(const std::vector<ring_ptr> &rings, size_t size, std::vector<slot *> &claimed)
+{
+    // each ring's slots in the order they were stored
+    std::vector<std::pair<size_t, size_t>> runs;
+    for (auto &r : rings)
+    {
+        auto begin = claimed.size();
+        for (auto &s : r->slots)
+        {
+            auto state = s.state.load(std::memory_order_relaxed);
+            claimed.push_back(&s);
+            if (state != ready_slot || !s.state.compare_exchange_strong(state, reading_slot, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                claimed.pop_back();
+            }
+        }
+        std::sort(claimed.begin() + static_cast<std::ptrdiff_t>(begin), claimed.end(), [](const slot *a, const slot *b) { return a->seq < b->seq; });
+        if (claimed.size() > begin)
+        {
+            runs.emplace_back(begin, claimed.size());
+        }
+    }
+
+    // merge the runs by time
+    std::vector<slot *> merged;
+    merged.reserve(claimed.size());
+    while (merged.size() < claimed.size())
+    {
+        std::pair<size_t, size_t> *oldest = nullptr;
+        for (auto &run : runs)
+        {
+            if (run.first < run.second && (oldest == nullptr || claimed[run.first]->msg.time < claimed[oldest->first]->msg.time))
+            {
+                oldest = &run;
+            }
+        }
+        merged.push_back(claimed[oldest->first++]);
+    }
+
+    // keep the last size messages of all threads
+    auto dropped = merged.size() > size ? merged.size() - size : 0;
+    for (size_t i = 0; i < dropped; i++)
+    {
+        merged[i]->state.store(free_slot, std::memory_order_release);
+    }
+    merged.erase(merged.begin(), merged.begin() + static_cast<std::ptrdiff_t>(dropped));
+    claimed.swap(merged);
+}
+
+#ifndef SPDLOG_NO_TLS
+SPDLOG_INLINE backtracer::local_rings::~local_rings()
+{
+    for (auto &r : rings)
+    {
+        r.second->closed.store(true, std::memory_order_release);
+    }
+}
+
+// the calling thread's ring, or null if there are none (not enabled, or size 0)
+SPDLOG_INLINE backtracer::ring *backtracer::local_ring_()
+{
+    static thread_local local_rings local;
+    static thread_local std::pair<size_t, ring *> last{0, nullptr};
+    auto id = id_.load(std::memory_order_acquire);
+    if (id == 0)
+    {
+        return nullptr;
+    }
+    if (last.first == id)
+    {
+        return last.second;
+    }
+    for (auto &r : local.rings)
+    {
+        if (r.first == id)
+        {
+            last = {id, r.second.get()};
+            return last.second;
+        }
+    }
+    return register_ring_(local, last);
+}
+
+SPDLOG_INLINE backtracer::ring *backtracer::register_ring_(local_rings &local, std::pair<size_t, ring *> &last)
+{
+    // drop rings of destroyed or re-enabled backtracers
+    for (auto it = local.rings.begin(); it != local.rings.end();)
+    {
+        it = it->second->orphaned.load(std::memory_order_relaxed) ? local.rings.erase(it) : std::next(it);
+    }
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    auto id = id_.load(std::memory_order_relaxed);
+    if (id == 0)
     {
-        auto &front_msg = messages_.front();
-        fun(front_msg);
-        messages_.pop_front();
+        return nullptr;
     }
+    // take over the ring of an exited thread, if any
+    ring_ptr r;
+    for (auto &candidate : rings_)
+    {
+        if (candidate->closed.load(std::memory_order_acquire))
+        {
+            r = candidate;
+            r->closed.store(false, std::memory_order_relaxed);
+            break;
+        }
+    }
+    if (!r)
+    {
+        r = std::make_shared<ring>(size_);
+        rings_.push_back(r);
+    }
+    local.rings.emplace_back(id, r);
+    last = {id, r.get()};
+    return r.get();
 }
+#endif
 } // namespace details
 } // namespace spdlog
@@ -4,22 +4,93 @@
 #pragma once
 
 #include <spdlog/details/log_msg_buffer.h>
-#include <spdlog/details/circular_q.h>
+#include <spdlog/details/deferred_format.h>
 
 #include <atomic>
+#include <cstdint>
+#include <memory>
 #include <mutex>
 #include <functional>
+#include <utility>
+#include <vector>
 
 // Store log messages in circular buffer.
 // Useful for storing debug data in case of error/warning happens.
+// Messages can be stored with their arguments serialized, to be formatted only when dumped.
+//
+// Each logging thread lazily gets its own ring of slots, so storing a message takes no lock:
+// the slots' states are handed over between the thread and the dump with atomics.
+// A message is dropped if its slot is being dumped at the time.
+// The slots are allocated when a thread first stores a message, and keep their buffers' capacity.
+// foreach_pop() merges the rings by the messages' time, and keeps the last size messages of all threads.
+// The ring of an exited thread keeps its messages, and is taken over by the next new thread.
+// Without thread local storage (SPDLOG_NO_TLS), all threads share a single ring under the lock.
 
 namespace spdlog {
 namespace details {
 class SPDLOG_API backtracer
 {
+    enum slot_state : unsigned char
+    {
+        free_slot,
+        writing_slot, // by the ring's thread
+        ready_slot,
+        reading_slot // by a dump or copy
+    };
+
+    struct slot
+    {
+        std::atomic<unsigned char> state{free_slot};
+        log_msg_buffer msg;
+        deferred_format_fn format_fn = nullptr; // set if msg's payload holds serialized arguments
+        uint64_t seq = 0;                      // order of the message in its ring
+    };
+
+    struct ring
+    {
+        explicit ring(size_t size)
+            : slots(size)
+        {}
+
+        std::vector<slot> slots;
+        uint64_t head = 0;                 // owned by the ring's thread: number of messages stored
+        std::atomic<bool> closed{false};   // thread exited: can be taken over
+        std::atomic<bool> orphaned{false}; // no longer used by the backtracer
+    };
+    using ring_ptr = std::shared_ptr<ring>;
+
+    // returns the claimed slots from next on to the ready state
+    struct claim_guard
+    {
+        std::vector<slot *> &claimed;
+        size_t next;
+        ~claim_guard();
+    };
+
+    // protects rings_ and size_, and serializes dumps and copies
     mutable std::mutex mutex_;
     std::atomic<bool> enabled_{false};
-    circular_q<log_msg_buffer> messages_;
+    std::atomic<size_t> id_{0}; // of the current rings, 0 if none
+    size_t size_ = 0;
+    std::vector<ring_ptr> rings_;
+
+    static size_t next_id_();
+    static void store_(ring &r, const log_msg &msg, deferred_format_fn format_fn);
+    void orphan_rings_();
+    // claim the last size stored messages of rings (in reading state), ordered by time. free the older ones.
+    static void claim_(const std::vector<ring_ptr> &rings, size_t size, std::vector<slot *> &claimed);
+
+#ifndef SPDLOG_NO_TLS
+    // rings of the calling thread, one per backtracer (by id). closes them when the thread exits.
+    struct local_rings
+    {
+        std::vector<std::pair<size_t, ring_ptr>> rings;
+        ~local_rings();
+    };
+
+    ring *local_ring_();
+    ring *register_ring_(local_rings &local, std::pair<size_t, ring *> &last);
+#endif
 
 public:
     backtracer() = default;
@@ -27,14 +98,18 @@ public:
 
     backtracer(backtracer &&other) SPDLOG_NOEXCEPT;
     backtracer &operator=(backtracer other);
+    ~backtracer();
 
     void enable(size_t size);
     void disable();
     bool enabled() const;
     void push_back(const log_msg &msg);
+    // msg's payload holds the arguments serialized by serialize_args(), to be formatted with format_fn
+    void push_back(const log_msg &msg, deferred_format_fn format_fn);
     bool empty() const;
 
-    // pop all items in the q and apply the given fun on each of them.
+    // pop all items in the q and apply the given fun on each of them (formatted).
+    // an item whose formatting throws is dropped, and the exception propagated (the rest stays queued).
     void foreach_pop(std::function<void(const details::log_msg &)> fun);
 };
 
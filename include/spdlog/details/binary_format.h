@@ -0,0 +1,63 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// Record layout of the files written by sinks::binary_file_sink (and read by binary_decoder).
+// Numbers are stored in the byte order and sizes of the writing process, strings as length (u32) and chars.
+//
+// header:  "SPDLOGB1", the sizes of size_t, long, long double and pointers (1 byte each), the byte order mark (u16).
+//          starts a new dictionary: written whenever a sink opens the file.
+// logger:  record_type::logger, id (u32), name.
+// format:  record_type::format, id (u32), source line (i32), source file, function, format string.
+// message: record_type::message, level (u8), format id (u32), logger id (u32), time (i64, ns since epoch),
+//          thread id (u64), arguments (u32 length, then as serialized by details::serialize_args after the format string).
+//
+// Messages whose arguments were formatted right away are stored with the format string "{}" and their text.
+
+#include <spdlog/common.h>
+
+#include <cstdint>
+#include <cstring>
+
+namespace spdlog {
+namespace details {
+namespace binary {
+
+static const char magic[8] = {'S', 'P', 'D', 'L', 'O', 'G', 'B', '1'};
+static const uint16_t byte_order_mark = 0x0102;
+static const size_t header_size = sizeof(magic) + 4 + sizeof(byte_order_mark);
+
+enum class record_type : unsigned char
+{
+    logger = 1,
+    format = 2,
+    message = 3
+};
+
+template<typename T>
+inline void put(memory_buf_t &dest, const T &value)
+{
+    auto p = reinterpret_cast<const char *>(&value);
+    dest.append(p, p + sizeof(T));
+}
+
+inline void put_string(memory_buf_t &dest, string_view_t str)
+{
+    put(dest, static_cast<uint32_t>(str.size()));
+    dest.append(str.data(), str.data() + str.size());
+}
+
+inline void put_header(memory_buf_t &dest)
+{
+    dest.append(magic, magic + sizeof(magic));
+    put(dest, static_cast<uint8_t>(sizeof(size_t)));
+    put(dest, static_cast<uint8_t>(sizeof(long)));
+    put(dest, static_cast<uint8_t>(sizeof(long double)));
+    put(dest, static_cast<uint8_t>(sizeof(void *)));
+    put(dest, byte_order_mark);
+}
+
+} // namespace binary
+} // namespace details
+} // namespace spdlog
@@ -0,0 +1,66 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#ifndef SPDLOG_HEADER_ONLY
+#    include <spdlog/details/callsite.h>
+#endif
+
+namespace spdlog {
+namespace details {
+
+SPDLOG_INLINE void callsite::register_site(const source_loc &loc, level::level_enum lvl, string_view_t fmt)
+{
+    uint32_t expected = 0;
+    if (!id_.compare_exchange_strong(expected, registering_id, std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    location_ = loc;
+    level_ = lvl;
+    uint64_t hash = 14695981039346656037ULL;
+    for (auto c : fmt)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    format_hash_ = hash;
+
+    auto &sites = sites_();
+    auto id = sites.next_id.fetch_add(1, std::memory_order_relaxed);
+    next_ = sites.head.load(std::memory_order_relaxed);
+    while (!sites.head.compare_exchange_weak(next_, this))
+    {}
+    // published after the site is on the list: once id() is set, find() reaches the site
+    id_.store(id, std::memory_order_release);
+}
+
+SPDLOG_INLINE const callsite *callsite::find(uint32_t id)
+{
+    for (auto site = sites_().head.load(std::memory_order_acquire); site != nullptr; site = site->next_)
+    {
+        if (id != 0 && site->id() == id)
+        {
+            return site;
+        }
+    }
+    return nullptr;
+}
+
+SPDLOG_INLINE size_t callsite::new_token()
+{
+    auto token = sites_().next_token.fetch_add(level::n_levels, std::memory_order_relaxed) + level::n_levels;
+    return token != 0 ? token : new_token();
+}
+
+// constant initialized and trivially destructible: usable from static destructors too
+SPDLOG_INLINE callsite::site_list &callsite::sites_()
+{
+    static site_list sites;
+    return sites;
+}
+
+} // namespace details
+} // namespace spdlog
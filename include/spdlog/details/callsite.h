@@ -0,0 +1,107 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#include <spdlog/common.h>
+
+#include <atomic>
+#include <cstdint>
+
+namespace spdlog {
+class logger;
+
+namespace details {
+
+// Static descriptor of a SPDLOG_LOGGER_CALL(..) call site.
+// Registered on the first call through the site: gets its location, level and the hash of its format string,
+// and an id to refer to it by (see find()).
+// Caches that the site is disabled for a logger and level, in a single word: the logger's token (see new_token())
+// plus the level. A disabled call is then a relaxed load of that word, compared against the logger's token.
+// A logger takes a new token whenever its level or backtrace changes, so the entry gets stale by itself.
+//
+// Sites are kept in a process wide list and never unregistered:
+// a shared library logging through the macros must not be unloaded.
+class SPDLOG_API callsite
+{
+public:
+    // constant initialized, so a function local static callsite needs no guard
+    SPDLOG_CONSTEXPR callsite() = default;
+
+    callsite(const callsite &) = delete;
+    callsite &operator=(const callsite &) = delete;
+
+    // 0 until registered
+    uint32_t id() const
+    {
+        auto id = id_.load(std::memory_order_acquire);
+        return id == registering_id ? 0 : id;
+    }
+
+    // valid once registered
+    const source_loc &location() const
+    {
+        return location_;
+    }
+
+    level::level_enum level() const
+    {
+        return level_;
+    }
+
+    // FNV-1a hash of the format string (or message) of the first call
+    uint64_t format_hash() const
+    {
+        return format_hash_;
+    }
+
+    // true if the site is known to be disabled for the level of the logger with the given token
+    bool disabled_for(size_t token, level::level_enum lvl) const
+    {
+        return disabled_.load(std::memory_order_relaxed) == token + static_cast<size_t>(lvl);
+    }
+
+    // register the site, unless registered already (or being registered by another thread).
+    void register_site(const source_loc &loc, level::level_enum lvl, string_view_t fmt);
+
+    // remember that the site is disabled for the level of the logger with the given token.
+    // token must have been read before the logger's level was checked: if it changed meanwhile, the entry is stale.
+    void cache_disabled(size_t token, level::level_enum lvl)
+    {
+        disabled_.store(token + static_cast<size_t>(lvl), std::memory_order_relaxed);
+    }
+
+    // the registered site with the given id, or nullptr
+    static const callsite *find(uint32_t id);
+
+    // a token no logger had before (until the counter wraps around). never 0, and spaced by the number of levels,
+    // so token + level is unique too.
+    static size_t new_token();
+
+private:
+    static constexpr uint32_t registering_id = UINT32_MAX;
+
+    struct site_list
+    {
+        std::atomic<callsite *> head{nullptr};
+        std::atomic<uint32_t> next_id{1};
+        std::atomic<size_t> next_token{0};
+    };
+
+    source_loc location_{};
+    level::level_enum level_{level::off};
+    uint64_t format_hash_{0};
+    callsite *next_{nullptr};
+    std::atomic<uint32_t> id_{0};
+    // token + level of the logger the site is disabled for, 0 if none
+    std::atomic<size_t> disabled_{0};
+
+    static site_list &sites_();
+};
+
+} // namespace details
+} // namespace spdlog
+
+#ifdef SPDLOG_HEADER_ONLY
+#    include "callsite-inl.h"
+#endif
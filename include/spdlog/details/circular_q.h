@@ -101,6 +101,19 @@ public:
         head_ = (head_ + 1) % max_items_;
     }
 
+    // Drop item by index and count it as overrun. The items before it move one slot ahead.
+    // If index is out of range 0…size()-1, the behavior is undefined.
+    void overrun_at(size_t i)
+    {
+        assert(i < size());
+        for (; i > 0; i--)
+        {
+            v_[(head_ + i) % max_items_] = std::move(v_[(head_ + i - 1) % max_items_]);
+        }
+        head_ = (head_ + 1) % max_items_;
+        ++overrun_counter_;
+    }
+
     bool empty() const
     {
         return tail_ == head_;
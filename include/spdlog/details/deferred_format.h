@@ -0,0 +1,297 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// Deferred formatting for async loggers.
+// serialize_args(..) copies the format string and the arguments into a byte buffer,
+// and returns the function that formats them later (on the thread pool).
+// Only arguments that can be copied safely are supported: arithmetic types, void pointers
+// and strings (whose contents get copied). Anything else (e.g. user types, which might
+// refer to other objects) must be formatted eagerly, so serialize_args(..) returns nullptr for them.
+//
+// Layout: the format string (length, chars), the number of arguments (1 byte), the type of each
+// argument (1 byte each, see arg_type), then the arguments (native representation, strings as length and chars).
+// The types make the data decodable without the log call's template arguments (see binary_decoder).
+
+#include <spdlog/common.h>
+
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+namespace spdlog {
+namespace details {
+
+// format the serialized format string and arguments in data into dest
+using deferred_format_fn = void (*)(string_view_t data, memory_buf_t &dest);
+
+namespace deferred {
+
+// type of a serialized argument
+enum class arg_type : unsigned char
+{
+    bool_type = 1,
+    char_type,
+    schar_type,
+    uchar_type,
+    short_type,
+    ushort_type,
+    int_type,
+    uint_type,
+    long_type,
+    ulong_type,
+    long_long_type,
+    ulong_long_type,
+    int128_type,
+    uint128_type,
+    float_type,
+    double_type,
+    long_double_type,
+    pointer_type,
+    null_pointer_type,
+    string_type
+};
+
+// defined for the types of deferrable arguments (other character types cannot be formatted as char anyway)
+template<typename T>
+struct arg_type_of;
+
+#define SPDLOG_DEFERRED_ARG_TYPE_(T, t)                                                                                                    \
+    template<>                                                                                                                             \
+    struct arg_type_of<T> : std::integral_constant<arg_type, arg_type::t>                                                                  \
+    {}
+
+SPDLOG_DEFERRED_ARG_TYPE_(bool, bool_type);
+SPDLOG_DEFERRED_ARG_TYPE_(char, char_type);
+SPDLOG_DEFERRED_ARG_TYPE_(signed char, schar_type);
+SPDLOG_DEFERRED_ARG_TYPE_(unsigned char, uchar_type);
+SPDLOG_DEFERRED_ARG_TYPE_(short, short_type);
+SPDLOG_DEFERRED_ARG_TYPE_(unsigned short, ushort_type);
+SPDLOG_DEFERRED_ARG_TYPE_(int, int_type);
+SPDLOG_DEFERRED_ARG_TYPE_(unsigned int, uint_type);
+SPDLOG_DEFERRED_ARG_TYPE_(long, long_type);
+SPDLOG_DEFERRED_ARG_TYPE_(unsigned long, ulong_type);
+SPDLOG_DEFERRED_ARG_TYPE_(long long, long_long_type);
+SPDLOG_DEFERRED_ARG_TYPE_(unsigned long long, ulong_long_type);
+#ifdef __SIZEOF_INT128__
+SPDLOG_DEFERRED_ARG_TYPE_(__int128_t, int128_type);
+SPDLOG_DEFERRED_ARG_TYPE_(__uint128_t, uint128_type);
+#endif
+SPDLOG_DEFERRED_ARG_TYPE_(float, float_type);
+SPDLOG_DEFERRED_ARG_TYPE_(double, double_type);
+SPDLOG_DEFERRED_ARG_TYPE_(long double, long_double_type);
+SPDLOG_DEFERRED_ARG_TYPE_(void *, pointer_type);
+SPDLOG_DEFERRED_ARG_TYPE_(const void *, pointer_type);
+SPDLOG_DEFERRED_ARG_TYPE_(std::nullptr_t, null_pointer_type);
+SPDLOG_DEFERRED_ARG_TYPE_(std::string, string_type);
+SPDLOG_DEFERRED_ARG_TYPE_(string_view_t, string_type);
+#if !defined(SPDLOG_USE_STD_FORMAT) && defined(FMT_USE_STRING_VIEW)
+SPDLOG_DEFERRED_ARG_TYPE_(std::string_view, string_type);
+#endif
+SPDLOG_DEFERRED_ARG_TYPE_(const char *, string_type);
+SPDLOG_DEFERRED_ARG_TYPE_(char *, string_type);
+
+#undef SPDLOG_DEFERRED_ARG_TYPE_
+
+template<typename T, typename = void>
+struct arg_traits
+{
+    static const bool deferrable = false;
+};
+
+// copied by value
+template<typename T>
+struct arg_traits<T, typename std::enable_if<std::is_arithmetic<T>::value || std::is_same<T, const void *>::value ||
+                                             std::is_same<T, void *>::value || std::is_same<T, std::nullptr_t>::value>::type>
+{
+    static const bool deferrable = true;
+
+    static bool can_defer(const T &)
+    {
+        return true;
+    }
+
+    static size_t size(const T &)
+    {
+        return sizeof(T);
+    }
+
+    static void write(char *&dest, const T &value)
+    {
+        std::memcpy(dest, &value, sizeof(T));
+        dest += sizeof(T);
+    }
+
+    static T read(const char *&src)
+    {
+        T value;
+        std::memcpy(&value, src, sizeof(T));
+        src += sizeof(T);
+        return value;
+    }
+};
+
+// contents copied, read back as string_view_t
+struct string_arg
+{
+    static const bool deferrable = true;
+
+    static bool can_defer(string_view_t)
+    {
+        return true;
+    }
+
+    static size_t size(string_view_t str)
+    {
+        return sizeof(size_t) + str.size();
+    }
+
+    static void write(char *&dest, string_view_t str)
+    {
+        size_t n = str.size();
+        std::memcpy(dest, &n, sizeof(size_t));
+        dest += sizeof(size_t);
+        if (n > 0)
+        {
+            std::memcpy(dest, str.data(), n);
+            dest += n;
+        }
+    }
+
+    static string_view_t read(const char *&src)
+    {
+        size_t n;
+        std::memcpy(&n, src, sizeof(size_t));
+        src += sizeof(size_t);
+        string_view_t str{src, n};
+        src += n;
+        return str;
+    }
+};
+
+template<>
+struct arg_traits<std::string> : string_arg
+{};
+
+template<>
+struct arg_traits<string_view_t> : string_arg
+{};
+
+#if !defined(SPDLOG_USE_STD_FORMAT) && defined(FMT_USE_STRING_VIEW)
+template<>
+struct arg_traits<std::string_view> : string_arg
+{};
+#endif
+
+template<typename Char>
+struct c_string_arg : string_arg
+{
+    // null pointers are reported by the formatter: leave that to eager formatting
+    static bool can_defer(const Char *str)
+    {
+        return str != nullptr;
+    }
+};
+
+template<>
+struct arg_traits<const char *> : c_string_arg<char>
+{};
+
+template<>
+struct arg_traits<char *> : c_string_arg<char>
+{};
+
+// up to 255 arguments (their number is stored in a byte)
+template<typename... Args>
+struct all_deferrable : std::integral_constant<bool, (sizeof...(Args) < 256)>
+{};
+
+template<typename Arg, typename... Rest>
+struct all_deferrable<Arg, Rest...> : std::integral_constant<bool, arg_traits<Arg>::deferrable && all_deferrable<Rest...>::value>
+{};
+
+template<typename... T>
+struct type_list
+{};
+
+// read the arguments one by one, then format them
+template<typename... Read>
+void format_read_(type_list<>, const char *, string_view_t fmt, memory_buf_t &dest, Read &...values)
+{
+#ifdef SPDLOG_USE_STD_FORMAT
+    fmt_lib::vformat_to(std::back_inserter(dest), fmt, fmt_lib::make_format_args(values...));
+#else
+    fmt::vformat_to(fmt::appender(dest), fmt, fmt::make_format_args(values...));
+#endif
+}
+
+template<typename Arg, typename... Rest, typename... Read>
+void format_read_(type_list<Arg, Rest...>, const char *src, string_view_t fmt, memory_buf_t &dest, Read &...values)
+{
+    auto value = arg_traits<Arg>::read(src);
+    format_read_(type_list<Rest...>{}, src, fmt, dest, values..., value);
+}
+
+template<typename... Args>
+void format_serialized(string_view_t data, memory_buf_t &dest)
+{
+    const char *src = data.data();
+    auto fmt = string_arg::read(src);
+    src += 1 + sizeof...(Args); // types
+    format_read_(type_list<Args...>{}, src, fmt, dest);
+}
+
+template<typename... Args>
+deferred_format_fn serialize_(std::false_type, memory_buf_t &, string_view_t, const Args &...)
+{
+    return nullptr;
+}
+
+template<typename... Args>
+deferred_format_fn serialize_(std::true_type, memory_buf_t &dest, string_view_t fmt, const Args &...args)
+{
+    bool can_defer[] = {true, arg_traits<Args>::can_defer(args)...};
+    for (bool b : can_defer)
+    {
+        if (!b)
+        {
+            return nullptr;
+        }
+    }
+    size_t sizes[] = {string_arg::size(fmt), 1 + sizeof...(Args), arg_traits<Args>::size(args)...};
+    size_t total = 0;
+    for (size_t n : sizes)
+    {
+        total += n;
+    }
+
+    dest.resize(total);
+    char *p = &dest[0];
+    string_arg::write(p, fmt);
+    const arg_type types[] = {arg_type::bool_type, arg_type_of<Args>::value...};
+    *p++ = static_cast<char>(sizeof...(Args));
+    for (size_t i = 1; i <= sizeof...(Args); i++)
+    {
+        *p++ = static_cast<char>(types[i]);
+    }
+    int unused[] = {0, (arg_traits<Args>::write(p, args), 0)...};
+    (void)unused;
+    return &format_serialized<Args...>;
+}
+
+} // namespace deferred
+
+// serialize fmt and args into dest.
+// return the function to format them with, or nullptr if they must be formatted right away.
+template<typename... Args>
+deferred_format_fn serialize_args(memory_buf_t &dest, string_view_t fmt, const Args &...args)
+{
+    // decay const Args, so char arrays become const char *
+    using deferrable = deferred::all_deferrable<typename std::decay<const Args>::type...>;
+    return deferred::serialize_<typename std::decay<const Args>::type...>(
+        std::integral_constant<bool, deferrable::value>{}, dest, fmt, args...);
+}
+
+} // namespace details
+} // namespace spdlog
@@ -3,6 +3,8 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <type_traits>
 #include <iterator>
 #include <spdlog/fmt/fmt.h>
@@ -93,12 +95,110 @@ inline unsigned int count_digits(T n)
 #endif
 }
 
+// the two digits of n (0-99)
+inline const char *digits2(unsigned int n)
+{
+    static const char table[] = "0001020304050607080910111213141516171819"
+                                "2021222324252627282930313233343536373839"
+                                "4041424344454647484950515253545556575859"
+                                "6061626364656667686970717273747576777879"
+                                "8081828384858687888990919293949596979899";
+    return table + n * 2;
+}
+
+// on little endian targets, digits are rendered 8 at a time in a 64 bit integer (one byte per digit),
+// and written to the buffer with whole 8 byte stores. elsewhere two at a time from the digits2() table.
+#if defined(_WIN32) || (defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#    define SPDLOG_DIGITS8_
+
+// the 8 digits of n (below 10^8), the first one in the lowest byte
+inline uint64_t digits8(uint32_t n)
+{
+    // 4 digits per 32 bit lane, then 2 per 16 bit lane, then 1 per byte
+    uint64_t fours = static_cast<uint64_t>(n / 10000) | (static_cast<uint64_t>(n % 10000) << 32);
+    uint64_t hundreds = ((fours * 10486) >> 20) & 0x0000007F0000007FULL; // / 100
+    uint64_t twos = ((fours - 100 * hundreds) << 16) | hundreds;
+    uint64_t tens = ((twos * 103) >> 10) & 0x000F000F000F000FULL; // / 10
+    uint64_t ones = ((twos - 10 * tens) << 8) | tens;
+    return ones + 0x3030303030303030ULL;
+}
+#endif
+
+// append n (below 10^Width) as Width digits
+template<unsigned int Width>
+inline void append_fixed(uint32_t n, memory_buf_t &dest)
+{
+    static_assert(Width >= 1 && Width <= 9, "append_fixed supports 1 to 9 digits");
+#ifdef SPDLOG_DIGITS8_
+    const size_t size = dest.size();
+    dest.resize(size + 9);
+    char *p = &dest[size];
+    if (Width == 9)
+    {
+        *p++ = static_cast<char>('0' + n / 100000000);
+        n %= 100000000;
+    }
+    const uint64_t digits = digits8(n) >> (8 * (8 - (Width < 8 ? Width : 8)));
+    std::memcpy(p, &digits, sizeof(digits));
+    dest.resize(size + Width);
+#else
+    char buf[Width];
+    char *p = buf + Width;
+    for (unsigned int i = 0; i < Width / 2; i++)
+    {
+        p -= 2;
+        std::memcpy(p, digits2(n % 100), 2);
+        n /= 100;
+    }
+    if (Width % 2 != 0)
+    {
+        *--p = static_cast<char>('0' + n);
+    }
+    dest.append(buf, buf + Width);
+#endif
+}
+
+// append n in decimal (e.g. thread ids and pids)
+inline void append_uint(uint64_t n, memory_buf_t &dest)
+{
+#ifdef SPDLOG_DIGITS8_
+    const unsigned int count = count_digits(n);
+    // the leading digits first (an 8 byte store that may spill over the next ones), then the groups of 8
+    uint32_t groups[2];
+    unsigned int group_count = 0;
+    while (n >= 100000000)
+    {
+        groups[group_count++] = static_cast<uint32_t>(n % 100000000);
+        n /= 100000000;
+    }
+    const unsigned int leading = count - 8 * group_count;
+    const size_t size = dest.size();
+    dest.resize(size + count + 8);
+    char *p = &dest[size];
+    uint64_t digits = digits8(static_cast<uint32_t>(n)) >> (8 * (8 - leading));
+    std::memcpy(p, &digits, sizeof(digits));
+    p += leading;
+    while (group_count > 0)
+    {
+        digits = digits8(groups[--group_count]);
+        std::memcpy(p, &digits, sizeof(digits));
+        p += 8;
+    }
+    dest.resize(size + count);
+#else
+    append_int(n, dest);
+#endif
+}
+
+#undef SPDLOG_DIGITS8_
+
 inline void pad2(int n, memory_buf_t &dest)
 {
     if (n >= 0 && n < 100) // 0-99
     {
-        dest.push_back(static_cast<char>('0' + n / 10));
-        dest.push_back(static_cast<char>('0' + n % 10));
+        const char *digits = digits2(static_cast<unsigned int>(n));
+        dest.push_back(digits[0]);
+        dest.push_back(digits[1]);
     }
     else // unlikely, but just in case, let fmt deal with it
     {
@@ -123,10 +223,10 @@ inline void pad3(T n, memory_buf_t &dest)
     static_assert(std::is_unsigned<T>::value, "pad3 must get unsigned T");
     if (n < 1000)
     {
+        const char *digits = digits2(static_cast<unsigned int>(n % 100));
         dest.push_back(static_cast<char>(n / 100 + '0'));
-        n = n % 100;
-        dest.push_back(static_cast<char>((n / 10) + '0'));
-        dest.push_back(static_cast<char>((n % 10) + '0'));
+        dest.push_back(digits[0]);
+        dest.push_back(digits[1]);
     }
     else
     {
@@ -137,13 +237,27 @@ inline void pad3(T n, memory_buf_t &dest)
 template<typename T>
 inline void pad6(T n, memory_buf_t &dest)
 {
-    pad_uint(n, 6, dest);
+    if (n < 1000000)
+    {
+        append_fixed<6>(static_cast<uint32_t>(n), dest);
+    }
+    else
+    {
+        pad_uint(n, 6, dest);
+    }
 }
 
 template<typename T>
 inline void pad9(T n, memory_buf_t &dest)
 {
-    pad_uint(n, 9, dest);
+    if (n < 1000000000)
+    {
+        append_fixed<9>(static_cast<uint32_t>(n), dest);
+    }
+    else
+    {
+        pad_uint(n, 9, dest);
+    }
 }
 
 // return fraction of a second of the given time_point.
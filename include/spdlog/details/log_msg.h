@@ -8,6 +8,24 @@
 
 namespace spdlog {
 namespace details {
+// text of a message formatted for one sink, for the logger's other sinks whose formatter has the same key
+// (see formatter::format_shared()). the color range is relative to the text.
+struct format_cache
+{
+    bool filled = false;
+    memory_buf_t key;
+    memory_buf_t text;
+    size_t color_range_start = 0;
+    size_t color_range_end = 0;
+
+    void reset()
+    {
+        filled = false;
+        key.clear();
+        text.clear();
+    }
+};
+
 struct SPDLOG_API log_msg
 {
     log_msg() = default;
@@ -28,6 +46,14 @@ struct SPDLOG_API log_msg
 
     source_loc source;
     string_view_t payload;
+
+    // the format string and arguments as serialized by details::serialize_args, for sinks that store them
+    // unformatted (sinks::sink::wants_serialized()). empty if the log call's arguments were formatted right away.
+    // payload is empty if none of the logger's sinks needs the formatted text.
+    string_view_t serialized;
+
+    // set by the logger while it hands the message to its sinks, if it has several of them.
+    mutable format_cache *fmt_cache{nullptr};
 };
 } // namespace details
 } // namespace spdlog
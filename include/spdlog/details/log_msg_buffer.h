@@ -23,6 +23,9 @@ public:
     log_msg_buffer(log_msg_buffer &&other) SPDLOG_NOEXCEPT;
     log_msg_buffer &operator=(const log_msg_buffer &other);
     log_msg_buffer &operator=(log_msg_buffer &&other) SPDLOG_NOEXCEPT;
+
+    // copy orig_msg, reusing the buffer's capacity
+    void assign(const log_msg &orig_msg);
 };
 
 } // namespace details
@@ -7,11 +7,24 @@
 // enqueue(..) - will block until room found to put the new message.
 // enqueue_nowait(..) - will return immediately with false if no room left in
 // the queue.
+// try_enqueue(..) - will return immediately with false if no room left, without
+// enqueueing the new message.
+// enqueue_for(..) - will block until room found or timeout have passed.
 // dequeue_for(..) - will block until the queue is not empty or timeout have
 // passed.
+// dequeue_bulk(..) - will block until the queue is not empty, then pop up to
+// max_items under a single lock.
+//
+// Consumers wait according to their wait_strategy: with the spinning strategies they
+// first poll a lock-free copy of the queue size, and only then sleep on the condition variable.
+// The number of sleeping producers/consumers is tracked under the mutex, so nobody gets
+// notified while the other side is awake.
 
 #include <spdlog/details/circular_q.h>
+#include <spdlog/details/spin_wait.h>
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 
@@ -23,59 +36,175 @@ class mpmc_blocking_queue
 {
 public:
     using item_type = T;
-    explicit mpmc_blocking_queue(size_t max_items)
+    explicit mpmc_blocking_queue(size_t max_items, wait_strategy wait = wait_strategy{})
         : q_(max_items)
+        , wait_(wait)
     {}
 
 #ifndef __MINGW32__
     // try to enqueue and block if no room left
     void enqueue(T &&item)
     {
+        bool wake;
         {
             std::unique_lock<std::mutex> lock(queue_mutex_);
-            pop_cv_.wait(lock, [this] { return !this->q_.full(); });
-            q_.push_back(std::move(item));
+            wait_not_full_(lock, nullptr);
+            wake = push_(std::move(item));
+        }
+        if (wake)
+        {
+            push_cv_.notify_one();
         }
-        push_cv_.notify_one();
     }
 
     // enqueue immediately. overrun oldest message in the queue if no room left.
     void enqueue_nowait(T &&item)
     {
+        enqueue_nowait(std::move(item), [](const T &) { return true; });
+    }
+
+    // same, but pass the overrun message to on_overrun before it gets discarded.
+    // items on_overrun returns false for are kept, and the oldest item after them is overrun instead.
+    // (if it keeps them all, wait for room)
+    template<typename OnOverrun>
+    void enqueue_nowait(T &&item, OnOverrun on_overrun)
+    {
+        bool wake;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            if (q_.full() && !overrun_(on_overrun))
+            {
+                wait_not_full_(lock, nullptr);
+            }
+            wake = push_(std::move(item));
+        }
+        if (wake)
+        {
+            push_cv_.notify_one();
+        }
+    }
+
+    // enqueue if there is room left.
+    // Return true, if succeeded enqueue item, false otherwise
+    bool try_enqueue(T &&item)
+    {
+        bool wake;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            if (q_.full())
+            {
+                return false;
+            }
+            wake = push_(std::move(item));
+        }
+        if (wake)
+        {
+            push_cv_.notify_one();
+        }
+        return true;
+    }
+
+    // enqueue with a timeout.
+    // Return true, if succeeded enqueue item, false otherwise
+    bool enqueue_for(T &&item, std::chrono::microseconds wait_duration)
+    {
+        auto deadline = std::chrono::steady_clock::now() + wait_duration;
+        bool wake;
         {
             std::unique_lock<std::mutex> lock(queue_mutex_);
-            q_.push_back(std::move(item));
+            if (!wait_not_full_(lock, &deadline))
+            {
+                return false;
+            }
+            wake = push_(std::move(item));
         }
-        push_cv_.notify_one();
+        if (wake)
+        {
+            push_cv_.notify_one();
+        }
+        return true;
     }
 
     // dequeue with a timeout.
     // Return true, if succeeded dequeue item, false otherwise
     bool dequeue_for(T &popped_item, std::chrono::milliseconds wait_duration)
     {
+        auto deadline = std::chrono::steady_clock::now() + wait_duration;
+        bool wake;
         {
             std::unique_lock<std::mutex> lock(queue_mutex_);
-            if (!push_cv_.wait_for(lock, wait_duration, [this] { return !this->q_.empty(); }))
+            if (!wait_not_empty_(lock, &deadline))
             {
                 return false;
             }
-            popped_item = std::move(q_.front());
-            q_.pop_front();
+            wake = pop_(popped_item);
+        }
+        if (wake)
+        {
+            pop_cv_.notify_one();
         }
-        pop_cv_.notify_one();
         return true;
     }
 
     // blocking dequeue without a timeout.
     void dequeue(T &popped_item)
     {
+        bool wake;
         {
             std::unique_lock<std::mutex> lock(queue_mutex_);
-            push_cv_.wait(lock, [this] { return !this->q_.empty(); });
-            popped_item = std::move(q_.front());
-            q_.pop_front();
+            wait_not_empty_(lock, nullptr);
+            wake = pop_(popped_item);
+        }
+        if (wake)
+        {
+            pop_cv_.notify_one();
         }
-        pop_cv_.notify_one();
+    }
+
+    // blocking dequeue of up to max_items items.
+    // Return number of items dequeued (at least one).
+    size_t dequeue_bulk(T *items, size_t max_items)
+    {
+        size_t n = 0;
+        bool wake = false;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            wait_not_empty_(lock, nullptr);
+            for (; n < max_items && !q_.empty(); n++)
+            {
+                wake = pop_(items[n]);
+            }
+        }
+        if (wake)
+        {
+            pop_cv_.notify_all();
+        }
+        return n;
+    }
+
+    // dequeue of up to max_items items, waiting up to wait_duration for the first one.
+    // Return number of items dequeued (zero if none arrived in time).
+    size_t dequeue_bulk_for(T *items, size_t max_items, std::chrono::milliseconds wait_duration)
+    {
+        auto deadline = std::chrono::steady_clock::now() + wait_duration;
+        size_t n = 0;
+        bool wake = false;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            if (!wait_not_empty_(lock, &deadline))
+            {
+                return 0;
+            }
+            for (; n < max_items && !q_.empty(); n++)
+            {
+                wake = pop_(items[n]);
+            }
+        }
+        if (wake)
+        {
+            pop_cv_.notify_all();
+        }
+        return n;
     }
 
 #else
@@ -86,31 +215,83 @@ public:
     void enqueue(T &&item)
     {
         std::unique_lock<std::mutex> lock(queue_mutex_);
-        pop_cv_.wait(lock, [this] { return !this->q_.full(); });
-        q_.push_back(std::move(item));
-        push_cv_.notify_one();
+        wait_not_full_(lock, nullptr);
+        if (push_(std::move(item)))
+        {
+            push_cv_.notify_one();
+        }
     }
 
     // enqueue immediately. overrun oldest message in the queue if no room left.
     void enqueue_nowait(T &&item)
+    {
+        enqueue_nowait(std::move(item), [](const T &) { return true; });
+    }
+
+    // same, but pass the overrun message to on_overrun before it gets discarded.
+    // items on_overrun returns false for are kept, and the oldest item after them is overrun instead.
+    // (if it keeps them all, wait for room)
+    template<typename OnOverrun>
+    void enqueue_nowait(T &&item, OnOverrun on_overrun)
     {
         std::unique_lock<std::mutex> lock(queue_mutex_);
-        q_.push_back(std::move(item));
-        push_cv_.notify_one();
+        if (q_.full() && !overrun_(on_overrun))
+        {
+            wait_not_full_(lock, nullptr);
+        }
+        if (push_(std::move(item)))
+        {
+            push_cv_.notify_one();
+        }
+    }
+
+    // enqueue if there is room left.
+    // Return true, if succeeded enqueue item, false otherwise
+    bool try_enqueue(T &&item)
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        if (q_.full())
+        {
+            return false;
+        }
+        if (push_(std::move(item)))
+        {
+            push_cv_.notify_one();
+        }
+        return true;
+    }
+
+    // enqueue with a timeout.
+    // Return true, if succeeded enqueue item, false otherwise
+    bool enqueue_for(T &&item, std::chrono::microseconds wait_duration)
+    {
+        auto deadline = std::chrono::steady_clock::now() + wait_duration;
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        if (!wait_not_full_(lock, &deadline))
+        {
+            return false;
+        }
+        if (push_(std::move(item)))
+        {
+            push_cv_.notify_one();
+        }
+        return true;
     }
 
     // dequeue with a timeout.
     // Return true, if succeeded dequeue item, false otherwise
     bool dequeue_for(T &popped_item, std::chrono::milliseconds wait_duration)
     {
+        auto deadline = std::chrono::steady_clock::now() + wait_duration;
         std::unique_lock<std::mutex> lock(queue_mutex_);
-        if (!push_cv_.wait_for(lock, wait_duration, [this] { return !this->q_.empty(); }))
+        if (!wait_not_empty_(lock, &deadline))
         {
             return false;
         }
-        popped_item = std::move(q_.front());
-        q_.pop_front();
-        pop_cv_.notify_one();
+        if (pop_(popped_item))
+        {
+            pop_cv_.notify_one();
+        }
         return true;
     }
 
@@ -118,10 +299,53 @@ public:
     void dequeue(T &popped_item)
     {
         std::unique_lock<std::mutex> lock(queue_mutex_);
-        push_cv_.wait(lock, [this] { return !this->q_.empty(); });
-        popped_item = std::move(q_.front());
-        q_.pop_front();
-        pop_cv_.notify_one();
+        wait_not_empty_(lock, nullptr);
+        if (pop_(popped_item))
+        {
+            pop_cv_.notify_one();
+        }
+    }
+
+    // blocking dequeue of up to max_items items.
+    // Return number of items dequeued (at least one).
+    size_t dequeue_bulk(T *items, size_t max_items)
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        wait_not_empty_(lock, nullptr);
+        size_t n = 0;
+        bool wake = false;
+        for (; n < max_items && !q_.empty(); n++)
+        {
+            wake = pop_(items[n]);
+        }
+        if (wake)
+        {
+            pop_cv_.notify_all();
+        }
+        return n;
+    }
+
+    // dequeue of up to max_items items, waiting up to wait_duration for the first one.
+    // Return number of items dequeued (zero if none arrived in time).
+    size_t dequeue_bulk_for(T *items, size_t max_items, std::chrono::milliseconds wait_duration)
+    {
+        auto deadline = std::chrono::steady_clock::now() + wait_duration;
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        if (!wait_not_empty_(lock, &deadline))
+        {
+            return 0;
+        }
+        size_t n = 0;
+        bool wake = false;
+        for (; n < max_items && !q_.empty(); n++)
+        {
+            wake = pop_(items[n]);
+        }
+        if (wake)
+        {
+            pop_cv_.notify_all();
+        }
+        return n;
     }
 
 #endif
@@ -132,10 +356,10 @@ public:
         return q_.overrun_counter();
     }
 
+    // lock-free. exact when there are no concurrent operations.
     size_t size()
     {
-        std::unique_lock<std::mutex> lock(queue_mutex_);
-        return q_.size();
+        return size_.load(std::memory_order_relaxed);
     }
 
     void reset_overrun_counter()
@@ -145,10 +369,112 @@ public:
     }
 
 private:
+    using time_point = std::chrono::steady_clock::time_point;
+
+    // push/pop with the mutex held. return true if a waiting consumer/producer should be notified.
+    bool push_(T &&item)
+    {
+        q_.push_back(std::move(item));
+        size_.store(q_.size(), std::memory_order_relaxed);
+        return consumers_waiting_ > 0;
+    }
+
+    bool pop_(T &popped_item)
+    {
+        popped_item = std::move(q_.front());
+        q_.pop_front();
+        size_.store(q_.size(), std::memory_order_relaxed);
+        return producers_waiting_ > 0;
+    }
+
+    // drop the oldest item on_overrun lets go of, with the mutex held. return false if it keeps all of them.
+    template<typename OnOverrun>
+    bool overrun_(OnOverrun &on_overrun)
+    {
+        for (size_t i = 0; i < q_.size(); i++)
+        {
+            if (on_overrun(q_.at(i)))
+            {
+                q_.overrun_at(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // wait (with the mutex held) until there is room, or deadline (if not null) passed.
+    // return false on timeout.
+    bool wait_not_full_(std::unique_lock<std::mutex> &lock, const time_point *deadline)
+    {
+        if (!q_.full())
+        {
+            return true;
+        }
+        producers_waiting_++;
+        auto has_room = [this] { return !this->q_.full(); };
+        bool succeeded = true;
+        if (deadline)
+        {
+            succeeded = pop_cv_.wait_until(lock, *deadline, has_room);
+        }
+        else
+        {
+            pop_cv_.wait(lock, has_room);
+        }
+        producers_waiting_--;
+        return succeeded;
+    }
+
+    // wait (with the mutex held) until the queue is not empty, or deadline (if not null) passed.
+    // spins on size_ outside the lock while the wait strategy allows, then sleeps on push_cv_.
+    // return false on timeout.
+    bool wait_not_empty_(std::unique_lock<std::mutex> &lock, const time_point *deadline)
+    {
+        bool spinning = wait_.kind != async_wait_strategy::blocking;
+        unsigned attempt = 0;
+        while (q_.empty())
+        {
+            if (deadline && std::chrono::steady_clock::now() >= *deadline)
+            {
+                return false;
+            }
+            if (spinning)
+            {
+                lock.unlock();
+                while (size_.load(std::memory_order_relaxed) == 0 && (spinning = wait_.backoff(attempt++)))
+                {
+                    if (deadline && std::chrono::steady_clock::now() >= *deadline)
+                    {
+                        break;
+                    }
+                }
+                lock.lock();
+                continue;
+            }
+            consumers_waiting_++;
+            if (deadline)
+            {
+                push_cv_.wait_until(lock, *deadline);
+            }
+            else
+            {
+                push_cv_.wait(lock);
+            }
+            consumers_waiting_--;
+        }
+        return true;
+    }
+
     std::mutex queue_mutex_;
     std::condition_variable push_cv_;
     std::condition_variable pop_cv_;
     spdlog::details::circular_q<T> q_;
+    wait_strategy wait_;
+    // q_.size(), readable without the mutex
+    std::atomic<size_t> size_{0};
+    // threads sleeping on push_cv_/pop_cv_. guarded by queue_mutex_.
+    size_t consumers_waiting_ = 0;
+    size_t producers_waiting_ = 0;
 };
 } // namespace details
 } // namespace spdlog
@@ -0,0 +1,392 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// multi producer-multi consumer bounded lock-free queue.
+// Based on Dmitry Vyukov's bounded MPMC queue: every slot carries a sequence
+// number, so producers and consumers only contend on their own position counter.
+// The capacity is max_items rounded up to a power of two.
+// Same interface as mpmc_blocking_queue, so thread_pool can use either of them:
+// enqueue(..) - spin, yield and finally park until room found to put the new message.
+// enqueue_nowait(..) - overrun oldest message in the queue if no room left.
+// try_enqueue(..) - return false right away if no room left.
+// enqueue_for(..) - like enqueue(..), but give up once timeout have passed.
+// dequeue_for(..) - spin, yield and finally park until the queue is not empty or timeout have passed.
+// dequeue_bulk(..) - like dequeue(..), then pop up to max_items without waiting for more.
+//
+// Consumers spin, yield and park according to their wait_strategy (producers waiting for room
+// always spin, yield and park). Waiting threads park on a condition variable, but only after
+// announcing themselves in an atomic waiters counter. Producers and consumers skip the notify (and the mutex) entirely
+// while nobody is parked.
+
+#include <spdlog/common.h>
+#include <spdlog/details/spin_wait.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+namespace spdlog {
+namespace details {
+
+template<typename T>
+class mpmc_lockfree_queue
+{
+public:
+    using item_type = T;
+
+    explicit mpmc_lockfree_queue(size_t max_items, wait_strategy wait = wait_strategy{})
+        : wait_(wait)
+    {
+        if (max_items == 0 || max_items > (SIZE_MAX >> 1) + 1)
+        {
+            throw_spdlog_ex("spdlog::mpmc_lockfree_queue(): max_items out of range");
+        }
+        max_items_ = 1;
+        while (max_items_ < max_items)
+        {
+            max_items_ <<= 1;
+        }
+        mask_ = max_items_ - 1;
+        cells_.reset(new cell[max_items_]);
+        for (size_t i = 0; i < max_items_; i++)
+        {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    mpmc_lockfree_queue(const mpmc_lockfree_queue &) = delete;
+    mpmc_lockfree_queue &operator=(const mpmc_lockfree_queue &) = delete;
+
+    // try to enqueue and block if no room left
+    void enqueue(T &&item)
+    {
+        for (unsigned attempt = 0; !try_push_(item); attempt++)
+        {
+            if (!spin_backoff(attempt))
+            {
+                park_(pop_cv_, producers_waiting_, [this, &item] { return this->try_push_(item); });
+                break;
+            }
+        }
+        wake_(push_cv_, consumers_waiting_);
+    }
+
+    // enqueue immediately. overrun oldest message in the queue if no room left.
+    void enqueue_nowait(T &&item)
+    {
+        enqueue_nowait(std::move(item), [](const T &) { return true; });
+    }
+
+    // same, but pass the overrun message to on_overrun before it gets discarded.
+    // items on_overrun returns false for are kept: they get pushed again, ahead of item.
+    template<typename OnOverrun>
+    void enqueue_nowait(T &&item, OnOverrun on_overrun)
+    {
+        push_overrun_(item, on_overrun);
+        wake_(push_cv_, consumers_waiting_);
+    }
+
+    // enqueue if there is room left.
+    // Return true, if succeeded enqueue item, false otherwise
+    bool try_enqueue(T &&item)
+    {
+        if (!try_push_(item))
+        {
+            return false;
+        }
+        wake_(push_cv_, consumers_waiting_);
+        return true;
+    }
+
+    // enqueue with a timeout.
+    // Return true, if succeeded enqueue item, false otherwise
+    bool enqueue_for(T &&item, std::chrono::microseconds wait_duration)
+    {
+        auto deadline = std::chrono::steady_clock::now() + wait_duration;
+        for (unsigned attempt = 0; !try_push_(item); attempt++)
+        {
+            if (!spin_backoff(attempt))
+            {
+                if (!park_until_(pop_cv_, producers_waiting_, deadline, [this, &item] { return this->try_push_(item); }))
+                {
+                    return false;
+                }
+                break;
+            }
+        }
+        wake_(push_cv_, consumers_waiting_);
+        return true;
+    }
+
+    // dequeue with a timeout.
+    // Return true, if succeeded dequeue item, false otherwise
+    bool dequeue_for(T &popped_item, std::chrono::milliseconds wait_duration)
+    {
+        auto deadline = std::chrono::steady_clock::now() + wait_duration;
+        for (unsigned attempt = 0; !try_pop_(popped_item); attempt++)
+        {
+            if (std::chrono::steady_clock::now() >= deadline)
+            {
+                return false;
+            }
+            if (!wait_.backoff(attempt))
+            {
+                if (!park_until_(push_cv_, consumers_waiting_, deadline, [this, &popped_item] { return this->try_pop_(popped_item); }))
+                {
+                    return false;
+                }
+                break;
+            }
+        }
+        wake_(pop_cv_, producers_waiting_);
+        return true;
+    }
+
+    // blocking dequeue without a timeout.
+    void dequeue(T &popped_item)
+    {
+        for (unsigned attempt = 0; !try_pop_(popped_item); attempt++)
+        {
+            if (!wait_.backoff(attempt))
+            {
+                park_(push_cv_, consumers_waiting_, [this, &popped_item] { return this->try_pop_(popped_item); });
+                break;
+            }
+        }
+        wake_(pop_cv_, producers_waiting_);
+    }
+
+    // blocking dequeue of up to max_items items.
+    // Return number of items dequeued (at least one).
+    size_t dequeue_bulk(T *items, size_t max_items)
+    {
+        for (unsigned attempt = 0; !try_pop_(items[0]); attempt++)
+        {
+            if (!wait_.backoff(attempt))
+            {
+                park_(push_cv_, consumers_waiting_, [this, items] { return this->try_pop_(items[0]); });
+                break;
+            }
+        }
+        size_t n = 1;
+        while (n < max_items && try_pop_(items[n]))
+        {
+            n++;
+        }
+        wake_(pop_cv_, producers_waiting_, n > 1);
+        return n;
+    }
+
+    // dequeue of up to max_items items, waiting up to wait_duration for the first one.
+    // Return number of items dequeued (zero if none arrived in time).
+    size_t dequeue_bulk_for(T *items, size_t max_items, std::chrono::milliseconds wait_duration)
+    {
+        auto deadline = std::chrono::steady_clock::now() + wait_duration;
+        for (unsigned attempt = 0; !try_pop_(items[0]); attempt++)
+        {
+            if (std::chrono::steady_clock::now() >= deadline)
+            {
+                return 0;
+            }
+            if (!wait_.backoff(attempt))
+            {
+                if (!park_until_(push_cv_, consumers_waiting_, deadline, [this, items] { return this->try_pop_(items[0]); }))
+                {
+                    return 0;
+                }
+                break;
+            }
+        }
+        size_t n = 1;
+        while (n < max_items && try_pop_(items[n]))
+        {
+            n++;
+        }
+        wake_(pop_cv_, producers_waiting_, n > 1);
+        return n;
+    }
+
+    size_t overrun_counter()
+    {
+        return overrun_counter_.value.load(std::memory_order_relaxed);
+    }
+
+    // approximate number of items in the queue (exact when there are no concurrent operations).
+    size_t size()
+    {
+        auto head = dequeue_pos_.value.load(std::memory_order_relaxed);
+        auto tail = enqueue_pos_.value.load(std::memory_order_relaxed);
+        auto n = tail - head;
+        return n <= max_items_ ? n : 0;
+    }
+
+    void reset_overrun_counter()
+    {
+        overrun_counter_.value.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    struct cell
+    {
+        std::atomic<size_t> sequence{0};
+        T data;
+    };
+
+    // positions are increasing counters, the slot index is position & mask_. the capacity being a power
+    // of two keeps the slot of a position right when the counters wrap around (on 32 bit platforms).
+    // a slot is free for the producer at position p when its sequence == p,
+    // and holds an item for the consumer at position p when its sequence == p + 1.
+    // sequences and positions are compared by their difference, which also survives the wrap around.
+    bool try_push_(T &item)
+    {
+        auto pos = enqueue_pos_.value.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell &c = cells_[pos & mask_];
+            auto seq = c.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+            if (diff == 0)
+            {
+                if (enqueue_pos_.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    c.data = std::move(item);
+                    c.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // full
+            }
+            else
+            {
+                pos = enqueue_pos_.value.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop_(T &popped_item)
+    {
+        auto pos = dequeue_pos_.value.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell &c = cells_[pos & mask_];
+            auto seq = c.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+            if (diff == 0)
+            {
+                if (dequeue_pos_.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    popped_item = std::move(c.data);
+                    c.sequence.store(pos + max_items_, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // empty
+            }
+            else
+            {
+                pos = dequeue_pos_.value.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // push, popping the oldest items until there is room. a popped item can't be put back in its place,
+    // so the ones on_overrun keeps move to the tail.
+    template<typename OnOverrun>
+    void push_overrun_(T &item, OnOverrun &on_overrun)
+    {
+        while (!try_push_(item))
+        {
+            T oldest;
+            if (!try_pop_(oldest))
+            {
+                continue;
+            }
+            if (on_overrun(oldest))
+            {
+                overrun_counter_.value.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                push_overrun_(oldest, on_overrun);
+            }
+        }
+    }
+
+    // announce in waiters, then sleep on cv until done() succeeds.
+    // the fence pairs with the one in wake_(): either the other side sees our waiters count,
+    // or we see its update when re-checking done().
+    template<typename Pred>
+    void park_(std::condition_variable &cv, std::atomic<size_t> &waiters, Pred done)
+    {
+        std::unique_lock<std::mutex> lock(park_mutex_);
+        waiters.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!done())
+        {
+            cv.wait(lock);
+        }
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // same as park_(), but give up at deadline. return false if done() did not succeed by then.
+    template<typename Pred>
+    bool park_until_(std::condition_variable &cv, std::atomic<size_t> &waiters, std::chrono::steady_clock::time_point deadline, Pred done)
+    {
+        std::unique_lock<std::mutex> lock(park_mutex_);
+        waiters.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool succeeded;
+        while (!(succeeded = done()))
+        {
+            if (cv.wait_until(lock, deadline) == std::cv_status::timeout)
+            {
+                succeeded = done();
+                break;
+            }
+        }
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+        return succeeded;
+    }
+
+    void wake_(std::condition_variable &cv, std::atomic<size_t> &waiters, bool all = false)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(park_mutex_);
+            }
+            if (all)
+            {
+                cv.notify_all();
+            }
+            else
+            {
+                cv.notify_one();
+            }
+        }
+    }
+
+    size_t max_items_;
+    size_t mask_;
+    wait_strategy wait_;
+    std::unique_ptr<cell[]> cells_;
+    padded_counter enqueue_pos_;
+    padded_counter dequeue_pos_;
+    padded_counter overrun_counter_;
+    std::atomic<size_t> consumers_waiting_{0};
+    std::atomic<size_t> producers_waiting_{0};
+    std::mutex park_mutex_;
+    std::condition_variable push_cv_;
+    std::condition_variable pop_cv_;
+};
+} // namespace details
+} // namespace spdlog
@@ -0,0 +1,350 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// multi producer-multi consumer blocking queue with two priority bands.
+// Same interface as mpmc_blocking_queue. BandFn tells which band an item goes to:
+// - high band items are popped first. to bound starvation of the low band, after max_high_streak
+//   high band items in a row (while low band items are waiting) the next item comes from the low band.
+// - low band items marked as barriers are not popped before the high band items posted before them,
+//   so a barrier is processed after all items posted before it, in either band. high band items posted
+//   after a barrier don't hold it back.
+// Each band has max_items capacity and overruns within itself, so a burst of low band items
+// never evicts high band items.
+// Consumers wait per wait_strategy like in mpmc_blocking_queue.
+
+#include <spdlog/details/circular_q.h>
+#include <spdlog/details/spin_wait.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace spdlog {
+namespace details {
+
+enum class priority_band
+{
+    high,
+    low,
+    low_barrier
+};
+
+template<typename T, typename BandFn>
+class mpmc_priority_queue
+{
+public:
+    using item_type = T;
+
+    mpmc_priority_queue(size_t max_items, BandFn band_fn, size_t max_high_streak, wait_strategy wait = wait_strategy{})
+        : high_(max_items)
+        , low_(max_items)
+        , band_fn_(band_fn)
+        , max_high_streak_(max_high_streak)
+        , wait_(wait)
+    {}
+
+    // try to enqueue and block if no room left in the item's band
+    void enqueue(T &&item)
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        auto &band = band_of_(item);
+        if (band.full())
+        {
+            producers_waiting_++;
+            pop_cv_.wait(lock, [&band] { return !band.full(); });
+            producers_waiting_--;
+        }
+        push_(band, std::move(item), lock);
+    }
+
+    // enqueue immediately. overrun oldest message in the item's band if no room left.
+    void enqueue_nowait(T &&item)
+    {
+        enqueue_nowait(std::move(item), [](const T &) { return true; });
+    }
+
+    // same, but pass the overrun message to on_overrun before it gets discarded.
+    // items on_overrun returns false for are kept, and the oldest item of the band after them is overrun instead.
+    // (if it keeps them all, wait for room)
+    template<typename OnOverrun>
+    void enqueue_nowait(T &&item, OnOverrun on_overrun)
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        auto &band = band_of_(item);
+        if (band.full() && !overrun_(band, on_overrun))
+        {
+            producers_waiting_++;
+            pop_cv_.wait(lock, [&band] { return !band.full(); });
+            producers_waiting_--;
+        }
+        push_(band, std::move(item), lock);
+    }
+
+    // enqueue if there is room left in the item's band.
+    // Return true, if succeeded enqueue item, false otherwise
+    bool try_enqueue(T &&item)
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        auto &band = band_of_(item);
+        if (band.full())
+        {
+            return false;
+        }
+        push_(band, std::move(item), lock);
+        return true;
+    }
+
+    // enqueue with a timeout.
+    // Return true, if succeeded enqueue item, false otherwise
+    bool enqueue_for(T &&item, std::chrono::microseconds wait_duration)
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        auto &band = band_of_(item);
+        if (band.full())
+        {
+            producers_waiting_++;
+            bool has_room = pop_cv_.wait_for(lock, wait_duration, [&band] { return !band.full(); });
+            producers_waiting_--;
+            if (!has_room)
+            {
+                return false;
+            }
+        }
+        push_(band, std::move(item), lock);
+        return true;
+    }
+
+    // dequeue with a timeout.
+    // Return true, if succeeded dequeue item, false otherwise
+    bool dequeue_for(T &popped_item, std::chrono::milliseconds wait_duration)
+    {
+        auto deadline = std::chrono::steady_clock::now() + wait_duration;
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        if (!wait_not_empty_(lock, &deadline))
+        {
+            return false;
+        }
+        pop_(popped_item);
+        finish_pop_(lock, false);
+        return true;
+    }
+
+    // blocking dequeue without a timeout.
+    void dequeue(T &popped_item)
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        wait_not_empty_(lock, nullptr);
+        pop_(popped_item);
+        finish_pop_(lock, false);
+    }
+
+    // blocking dequeue of up to max_items items.
+    // Return number of items dequeued (at least one).
+    size_t dequeue_bulk(T *items, size_t max_items)
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        wait_not_empty_(lock, nullptr);
+        size_t n = 0;
+        while (n < max_items && pop_(items[n]))
+        {
+            n++;
+        }
+        finish_pop_(lock, true);
+        return n;
+    }
+
+    // dequeue of up to max_items items, waiting up to wait_duration for the first one.
+    // Return number of items dequeued (zero if none arrived in time).
+    size_t dequeue_bulk_for(T *items, size_t max_items, std::chrono::milliseconds wait_duration)
+    {
+        auto deadline = std::chrono::steady_clock::now() + wait_duration;
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        if (!wait_not_empty_(lock, &deadline))
+        {
+            return 0;
+        }
+        size_t n = 0;
+        while (n < max_items && pop_(items[n]))
+        {
+            n++;
+        }
+        finish_pop_(lock, true);
+        return n;
+    }
+
+    size_t overrun_counter()
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        return high_.overrun_counter() + low_.overrun_counter();
+    }
+
+    // lock-free. exact when there are no concurrent operations.
+    size_t size()
+    {
+        return size_.load(std::memory_order_relaxed);
+    }
+
+    void reset_overrun_counter()
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        high_.reset_overrun_counter();
+        low_.reset_overrun_counter();
+    }
+
+private:
+    using time_point = std::chrono::steady_clock::time_point;
+
+    // high_tail: for barriers, the number of high band items pushed before them
+    struct entry
+    {
+        T item;
+        size_t high_tail;
+    };
+
+    circular_q<entry> &band_of_(const T &item)
+    {
+        return band_fn_(item) == priority_band::high ? high_ : low_;
+    }
+
+    // drop the oldest item of band on_overrun lets go of, with the mutex held. return false if it keeps all of them.
+    template<typename OnOverrun>
+    bool overrun_(circular_q<entry> &band, OnOverrun &on_overrun)
+    {
+        for (size_t i = 0; i < band.size(); i++)
+        {
+            if (on_overrun(band.at(i).item))
+            {
+                band.overrun_at(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // push with the mutex held, then release it and wake a sleeping consumer if any
+    void push_(circular_q<entry> &band, T &&item, std::unique_lock<std::mutex> &lock)
+    {
+        if (&band == &high_)
+        {
+            high_pushed_++;
+        }
+        band.push_back(entry{std::move(item), high_pushed_});
+        size_.store(high_.size() + low_.size(), std::memory_order_relaxed);
+        bool wake = consumers_waiting_ > 0;
+#ifndef __MINGW32__
+        lock.unlock();
+#endif
+        if (wake)
+        {
+            push_cv_.notify_one();
+        }
+        (void)lock;
+    }
+
+    // pop the next item by priority. return false if there is none.
+    bool pop_(T &popped_item)
+    {
+        bool low_waiting = !low_.empty();
+        bool take_high;
+        if (low_waiting && band_fn_(low_.front().item) == priority_band::low_barrier)
+        {
+            // the barrier goes as soon as the high band items pushed before it are gone (popped or overrun)
+            take_high = high_.size() > high_pushed_ - low_.front().high_tail;
+        }
+        else
+        {
+            take_high = !high_.empty() && (!low_waiting || high_streak_ < max_high_streak_);
+        }
+        auto &band = take_high ? high_ : low_;
+        if (band.empty())
+        {
+            return false;
+        }
+        popped_item = std::move(band.front().item);
+        band.pop_front();
+        high_streak_ = take_high && low_waiting ? high_streak_ + 1 : 0;
+        return true;
+    }
+
+    // release the mutex after popping, and wake the producers waiting for room if any
+    void finish_pop_(std::unique_lock<std::mutex> &lock, bool all)
+    {
+        size_.store(high_.size() + low_.size(), std::memory_order_relaxed);
+        bool wake = producers_waiting_ > 0;
+#ifndef __MINGW32__
+        lock.unlock();
+#endif
+        if (wake)
+        {
+            if (all)
+            {
+                pop_cv_.notify_all();
+            }
+            else
+            {
+                pop_cv_.notify_one();
+            }
+        }
+        (void)lock;
+    }
+
+    // same as mpmc_blocking_queue::wait_not_empty_()
+    bool wait_not_empty_(std::unique_lock<std::mutex> &lock, const time_point *deadline)
+    {
+        bool spinning = wait_.kind != async_wait_strategy::blocking;
+        unsigned attempt = 0;
+        while (high_.empty() && low_.empty())
+        {
+            if (deadline && std::chrono::steady_clock::now() >= *deadline)
+            {
+                return false;
+            }
+            if (spinning)
+            {
+                lock.unlock();
+                while (size_.load(std::memory_order_relaxed) == 0 && (spinning = wait_.backoff(attempt++)))
+                {
+                    if (deadline && std::chrono::steady_clock::now() >= *deadline)
+                    {
+                        break;
+                    }
+                }
+                lock.lock();
+                continue;
+            }
+            consumers_waiting_++;
+            if (deadline)
+            {
+                push_cv_.wait_until(lock, *deadline);
+            }
+            else
+            {
+                push_cv_.wait(lock);
+            }
+            consumers_waiting_--;
+        }
+        return true;
+    }
+
+    std::mutex queue_mutex_;
+    std::condition_variable push_cv_;
+    std::condition_variable pop_cv_;
+    circular_q<entry> high_;
+    circular_q<entry> low_;
+    BandFn band_fn_;
+    size_t max_high_streak_;
+    size_t high_streak_ = 0;
+    // number of items ever pushed to high_ (wraps around)
+    size_t high_pushed_ = 0;
+    wait_strategy wait_;
+    std::atomic<size_t> size_{0};
+    // guarded by queue_mutex_
+    size_t consumers_waiting_ = 0;
+    size_t producers_waiting_ = 0;
+};
+
+} // namespace details
+} // namespace spdlog
@@ -42,10 +42,13 @@
 #else // unix
 
 #    include <fcntl.h>
+#    include <pthread.h>
 #    include <unistd.h>
 
 #    ifdef __linux__
-#        include <sys/syscall.h> //Use gettid() syscall under linux to get thread id
+#        include <sched.h>        // for sched_setaffinity
+#        include <sys/resource.h> // for setpriority
+#        include <sys/syscall.h>  //Use gettid() syscall under linux to get thread id
 
 #    elif defined(_AIX)
 #        include <pthread.h> // for pthread_getthrds_np
@@ -630,6 +633,99 @@ SPDLOG_INLINE bool fsync(FILE *fp)
 #endif
 }
 
+SPDLOG_INLINE bool set_thread_affinity(const std::vector<size_t> &cpus)
+{
+    if (cpus.empty())
+    {
+        return false;
+    }
+#if defined(_WIN32)
+    DWORD_PTR mask = 0;
+    for (auto cpu : cpus)
+    {
+        if (cpu >= sizeof(DWORD_PTR) * 8)
+        {
+            return false;
+        }
+        mask |= DWORD_PTR(1) << cpu;
+    }
+    return ::SetThreadAffinityMask(::GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus)
+    {
+        if (cpu >= CPU_SETSIZE)
+        {
+            return false;
+        }
+        CPU_SET(cpu, &set);
+    }
+    return ::sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+SPDLOG_INLINE bool set_thread_priority(int nice, bool sched_batch)
+{
+#if defined(_WIN32)
+    if (sched_batch)
+    {
+        return false;
+    }
+    // map the nice range (-20..19) onto the windows thread priorities
+    int priority = THREAD_PRIORITY_NORMAL;
+    if (nice >= 10)
+    {
+        priority = THREAD_PRIORITY_LOWEST;
+    }
+    else if (nice > 0)
+    {
+        priority = THREAD_PRIORITY_BELOW_NORMAL;
+    }
+    else if (nice <= -10)
+    {
+        priority = THREAD_PRIORITY_HIGHEST;
+    }
+    else if (nice < 0)
+    {
+        priority = THREAD_PRIORITY_ABOVE_NORMAL;
+    }
+    return ::SetThreadPriority(::GetCurrentThread(), priority) != 0;
+#elif defined(__linux__)
+    if (sched_batch)
+    {
+        sched_param param{};
+        param.sched_priority = 0;
+        if (::sched_setscheduler(0, SCHED_BATCH, &param) != 0)
+        {
+            return false;
+        }
+    }
+    // on linux the nice value is per thread
+    return ::setpriority(PRIO_PROCESS, static_cast<id_t>(::syscall(SYS_gettid)), nice) == 0;
+#else
+    return nice == 0 && !sched_batch;
+#endif
+}
+
+SPDLOG_INLINE bool set_thread_name(const std::string &name)
+{
+    auto truncated = name.substr(0, 15);
+#if defined(__linux__) && defined(__GLIBC__)
+    return ::pthread_setname_np(::pthread_self(), truncated.c_str()) == 0;
+#elif defined(__APPLE__)
+    return ::pthread_setname_np(truncated.c_str()) == 0;
+#elif defined(__DragonFly__) || defined(__FreeBSD__)
+    ::pthread_set_name_np(::pthread_self(), truncated.c_str());
+    return true;
+#else
+    (void)truncated;
+    return false;
+#endif
+}
+
 } // namespace os
 } // namespace details
 } // namespace spdlog
@@ -5,6 +5,7 @@
 
 #include <spdlog/common.h>
 #include <ctime> // std::time_t
+#include <vector>
 
 namespace spdlog {
 namespace details {
@@ -113,6 +114,18 @@ SPDLOG_API std::string getenv(const char *field);
 // Return true on success.
 SPDLOG_API bool fsync(FILE *fp);
 
+// Pin the calling thread to the given cpus.
+// Return true on success (linux and windows only, on windows only cpus 0-63 of the current group).
+SPDLOG_API bool set_thread_affinity(const std::vector<size_t> &cpus);
+
+// Set the nice value of the calling thread, and on linux optionally switch it to SCHED_BATCH.
+// Return true on success.
+SPDLOG_API bool set_thread_priority(int nice, bool sched_batch);
+
+// Set the name of the calling thread (truncated to 15 chars, as required on linux).
+// Return true on success.
+SPDLOG_API bool set_thread_name(const std::string &name);
+
 } // namespace os
 } // namespace details
 } // namespace spdlog
@@ -0,0 +1,99 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#ifndef SPDLOG_HEADER_ONLY
+#    include <spdlog/details/scratch_buffer.h>
+#endif
+
+namespace spdlog {
+namespace details {
+
+SPDLOG_INLINE scratch_buffer::scratch_buffer()
+{
+#ifndef SPDLOG_NO_TLS
+    auto &flags = thread_flags_();
+    if (!flags.in_use && !flags.destroyed)
+    {
+        flags.in_use = true;
+        buf_ = &thread_state_().buf;
+        buf_->clear();
+        return;
+    }
+#endif
+    buf_ = new (own_) memory_buf_t();
+    owned_ = true;
+}
+
+SPDLOG_INLINE scratch_buffer::~scratch_buffer()
+{
+    if (owned_)
+    {
+        buf_->~memory_buf_t();
+        return;
+    }
+#ifndef SPDLOG_NO_TLS
+    if (buf_->capacity() > SPDLOG_SCRATCH_BUFFER_MAX_SIZE)
+    {
+        *buf_ = memory_buf_t();
+    }
+    thread_flags_().in_use = false;
+#endif
+}
+
+SPDLOG_INLINE scratch_format_cache::scratch_format_cache(bool wanted)
+{
+#ifndef SPDLOG_NO_TLS
+    if (!wanted)
+    {
+        return;
+    }
+    auto &flags = scratch_buffer::thread_flags_();
+    if (!flags.cache_in_use && !flags.destroyed)
+    {
+        flags.cache_in_use = true;
+        cache_ = &scratch_buffer::thread_state_().cache;
+        cache_->reset();
+    }
+#else
+    (void)wanted;
+#endif
+}
+
+SPDLOG_INLINE scratch_format_cache::~scratch_format_cache()
+{
+#ifndef SPDLOG_NO_TLS
+    if (cache_ == nullptr)
+    {
+        return;
+    }
+    if (cache_->text.capacity() > SPDLOG_SCRATCH_BUFFER_MAX_SIZE)
+    {
+        cache_->text = memory_buf_t();
+    }
+    scratch_buffer::thread_flags_().cache_in_use = false;
+#endif
+}
+
+#ifndef SPDLOG_NO_TLS
+SPDLOG_INLINE scratch_buffer::thread_state::~thread_state()
+{
+    thread_flags_().destroyed = true;
+}
+
+SPDLOG_INLINE scratch_buffer::thread_state &scratch_buffer::thread_state_()
+{
+    static thread_local thread_state state;
+    return state;
+}
+
+SPDLOG_INLINE scratch_buffer::thread_flags &scratch_buffer::thread_flags_()
+{
+    static thread_local thread_flags flags{false, false, false};
+    return flags;
+}
+#endif
+
+} // namespace details
+} // namespace spdlog
@@ -0,0 +1,94 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#include <spdlog/common.h>
+#include <spdlog/details/log_msg.h>
+
+#include <new>
+
+#ifndef SPDLOG_SCRATCH_BUFFER_MAX_SIZE
+#    define SPDLOG_SCRATCH_BUFFER_MAX_SIZE (64 * 1024)
+#endif
+
+namespace spdlog {
+namespace details {
+
+// Per thread buffer to format log messages into.
+// It keeps the capacity it grew to, so long messages don't allocate after warm up.
+// If it grew beyond SPDLOG_SCRATCH_BUFFER_MAX_SIZE, it is freed once the message was logged.
+// A nested use on the same thread (e.g. logging from a formatter or a sink) gets a buffer of its own,
+// and so does every use if thread local storage is disabled.
+class SPDLOG_API scratch_buffer
+{
+public:
+    scratch_buffer();
+    ~scratch_buffer();
+
+    scratch_buffer(const scratch_buffer &) = delete;
+    scratch_buffer &operator=(const scratch_buffer &) = delete;
+
+    memory_buf_t &get()
+    {
+        return *buf_;
+    }
+
+private:
+    friend class scratch_format_cache;
+
+    struct thread_state
+    {
+        memory_buf_t buf;
+        format_cache cache;
+        ~thread_state();
+    };
+
+    // trivially destructible, so it can still be read by the thread local destructors that run after
+    // thread_state's: a logger used by them falls back to a buffer of its own.
+    struct thread_flags
+    {
+        bool in_use;
+        bool cache_in_use;
+        bool destroyed;
+    };
+
+    memory_buf_t *buf_;
+    // the buffer of its own, constructed only when used
+    bool owned_ = false;
+    alignas(memory_buf_t) unsigned char own_[sizeof(memory_buf_t)];
+
+    static thread_state &thread_state_();
+    static thread_flags &thread_flags_();
+};
+
+// Per thread format cache for the sinks of a logger (see formatter::format_shared()), reset for each message.
+// Like scratch_buffer, it keeps its capacity up to SPDLOG_SCRATCH_BUFFER_MAX_SIZE.
+// A nested use on the same thread gets none (the sinks then format the message each),
+// and so does every use if thread local storage is disabled.
+class SPDLOG_API scratch_format_cache
+{
+public:
+    // no cache either if not wanted
+    explicit scratch_format_cache(bool wanted);
+    ~scratch_format_cache();
+
+    scratch_format_cache(const scratch_format_cache &) = delete;
+    scratch_format_cache &operator=(const scratch_format_cache &) = delete;
+
+    // null if there is none
+    format_cache *get()
+    {
+        return cache_;
+    }
+
+private:
+    format_cache *cache_ = nullptr;
+};
+
+} // namespace details
+} // namespace spdlog
+
+#ifdef SPDLOG_HEADER_ONLY
+#    include "scratch_buffer-inl.h"
+#endif
@@ -0,0 +1,114 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// Helpers for the queues: cache line size/alignment, spin-then-yield backoff and the consumer wait strategies.
+
+#include <spdlog/common.h>
+
+#include <atomic>
+#include <thread>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#    include <intrin.h>
+#endif
+
+namespace spdlog {
+
+// How idle thread pool workers wait for new messages.
+enum class async_wait_strategy
+{
+    blocking,   // sleep on a condition variable right away. lowest cpu usage.
+    spin_park,  // spin, then yield, then sleep. producers logging during the spin/yield phase skip the wake up.
+    spin_yield, // spin, then keep yielding. never sleeps.
+    busy_spin   // spin. never sleeps nor yields: burns a core per worker, for the lowest latency.
+};
+
+namespace details {
+
+static const size_t cache_line_size = 64;
+
+// align to cache line where over-aligned heap allocation is supported (C++17)
+#if defined(__cpp_aligned_new)
+#    define SPDLOG_CACHE_LINE_ALIGNED alignas(64)
+#else
+#    define SPDLOG_CACHE_LINE_ALIGNED
+#endif
+
+// atomic counter that sits on its own cache line, so counters written by
+// different threads do not share a line.
+struct padded_counter
+{
+    char pad[cache_line_size];
+    std::atomic<size_t> value{0};
+};
+
+// hint the cpu that we are in a spin-wait loop
+inline void cpu_relax() SPDLOG_NOEXCEPT
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_ia32_pause();
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__aarch64__) || defined(__arm__))
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// number of busy spins and yields before a waiting thread should park itself
+static const unsigned spin_limit = 256;
+static const unsigned yield_limit = 64;
+
+// spin first, then yield. return false when it is time to park.
+inline bool spin_backoff(unsigned attempt)
+{
+    if (attempt < spin_limit)
+    {
+        cpu_relax();
+        return true;
+    }
+    if (attempt < spin_limit + yield_limit)
+    {
+        std::this_thread::yield();
+        return true;
+    }
+    return false;
+}
+
+// consumer side backoff according to an async_wait_strategy
+struct wait_strategy
+{
+    async_wait_strategy kind = async_wait_strategy::blocking;
+    unsigned spins = spin_limit;  // busy spins before yielding (spin_park, spin_yield)
+    unsigned yields = yield_limit; // yields before sleeping (spin_park)
+
+    // called before retry number attempt. return false when it is time to sleep.
+    bool backoff(unsigned attempt) const
+    {
+        switch (kind)
+        {
+        case async_wait_strategy::busy_spin:
+            cpu_relax();
+            return true;
+        case async_wait_strategy::spin_yield:
+        case async_wait_strategy::spin_park:
+            if (attempt < spins)
+            {
+                cpu_relax();
+                return true;
+            }
+            if (kind == async_wait_strategy::spin_yield || attempt - spins < yields)
+            {
+                std::this_thread::yield();
+                return true;
+            }
+            return false;
+        default:
+            return false;
+        }
+    }
+};
+
+} // namespace details
+} // namespace spdlog
@@ -0,0 +1,116 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// single producer-single consumer bounded lock-free queue.
+// Exactly one thread may call the producer functions (try_push) and exactly one
+// other thread the consumer functions (front, pop_front, try_pop).
+// Each side keeps a cached copy of the other side's index, so in the common case
+// push and pop touch only their own cache line.
+
+#include <spdlog/details/spin_wait.h>
+
+#include <atomic>
+#include <vector>
+
+namespace spdlog {
+namespace details {
+
+template<typename T>
+class spsc_queue
+{
+public:
+    using item_type = T;
+
+    explicit spsc_queue(size_t max_items)
+        : max_items_(max_items + 1) // one item is reserved as marker for full q
+        , v_(max_items_)
+    {}
+
+    spsc_queue(const spsc_queue &) = delete;
+    spsc_queue &operator=(const spsc_queue &) = delete;
+
+    // producer: move the item into the queue. return false (item untouched) if no room left.
+    bool try_push(T &item)
+    {
+        auto tail = tail_.value.load(std::memory_order_relaxed);
+        auto next = next_index_(tail);
+        if (next == cached_head_)
+        {
+            cached_head_ = head_.value.load(std::memory_order_acquire);
+            if (next == cached_head_)
+            {
+                return false;
+            }
+        }
+        v_[tail] = std::move(item);
+        tail_.value.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // consumer: return pointer to the front item, or nullptr if the queue is empty.
+    T *front()
+    {
+        auto head = head_.value.load(std::memory_order_relaxed);
+        if (head == cached_tail_)
+        {
+            cached_tail_ = tail_.value.load(std::memory_order_acquire);
+            if (head == cached_tail_)
+            {
+                return nullptr;
+            }
+        }
+        return &v_[head];
+    }
+
+    // consumer: pop the front item.
+    // If there are no elements in the queue (front() returned nullptr), the behavior is undefined.
+    void pop_front()
+    {
+        auto head = head_.value.load(std::memory_order_relaxed);
+        head_.value.store(next_index_(head), std::memory_order_release);
+    }
+
+    // consumer: move the front item out of the queue. return false if empty.
+    bool try_pop(T &popped_item)
+    {
+        T *item = front();
+        if (item == nullptr)
+        {
+            return false;
+        }
+        popped_item = std::move(*item);
+        pop_front();
+        return true;
+    }
+
+    // safe to call from any thread. exact only when called by the producer or consumer.
+    bool empty() const
+    {
+        return head_.value.load(std::memory_order_acquire) == tail_.value.load(std::memory_order_acquire);
+    }
+
+    // approximate number of items in the queue
+    size_t size() const
+    {
+        auto head = head_.value.load(std::memory_order_acquire);
+        auto tail = tail_.value.load(std::memory_order_acquire);
+        return tail >= head ? tail - head : max_items_ - (head - tail);
+    }
+
+private:
+    size_t next_index_(size_t i) const
+    {
+        return ++i == max_items_ ? 0 : i;
+    }
+
+    size_t max_items_;
+    std::vector<T> v_;
+    padded_counter head_;    // written by consumer
+    size_t cached_tail_ = 0; // consumer's copy of tail_
+    padded_counter tail_;    // written by producer
+    size_t cached_head_ = 0; // producer's copy of head_
+};
+} // namespace details
+} // namespace spdlog
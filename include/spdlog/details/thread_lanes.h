@@ -0,0 +1,627 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// Per producer thread lanes for the async thread pool.
+// Each producer thread lazily gets its own spsc_queue (lane), registered with
+// one of the consumers (worker threads) in round robin order.
+// A consumer drains all its lanes and merges them by the items' time, so the
+// output order is globally sorted as long as no producer lags more than
+// max_skew behind the others.
+// Lanes are closed when their producer thread exits, and reclaimed by the consumer
+// once drained.
+// push_barrier() hands an item to a given consumer, after the items that are in its lanes at that time.
+// Lanes require thread local storage: they are not available if SPDLOG_NO_TLS is defined.
+
+#include <spdlog/common.h>
+#include <spdlog/details/spsc_q.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace spdlog {
+namespace details {
+
+template<typename T>
+class thread_lanes
+{
+public:
+    thread_lanes(size_t lane_size, size_t consumers_n, std::chrono::microseconds max_skew, wait_strategy wait = wait_strategy{})
+        : id_(next_id_())
+        , lane_size_(lane_size)
+        , max_skew_(max_skew)
+        , wait_(wait)
+        , consumers_(consumers_n)
+    {
+        if (lane_size_ == 0)
+        {
+            throw_spdlog_ex("spdlog::thread_lanes(): lane_size must be greater than zero");
+        }
+        for (auto &c : consumers_)
+        {
+            c = details::make_unique<consumer>();
+        }
+    }
+
+    ~thread_lanes()
+    {
+        // producer threads might still hold their lanes in thread local storage.
+        // mark them, so they get released on the next registration of that thread.
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        for (auto &c : consumers_)
+        {
+            for (auto &l : c->registered)
+            {
+                l->orphaned.store(true, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    thread_lanes(const thread_lanes &) = delete;
+    thread_lanes &operator=(const thread_lanes &) = delete;
+
+    // producer: push item to the calling thread's lane.
+    // if the lane is full, either wait for room (block == true), or drop the item and count it as overrun.
+    // return false if the item was dropped.
+    bool push(T &&item, bool block)
+    {
+        lane &l = local_lane_();
+        if (!block)
+        {
+            if (push_(l, item, nullptr))
+            {
+                return true;
+            }
+            l.overrun_counter.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        auto forever = std::chrono::steady_clock::time_point::max();
+        return push_(l, item, &forever);
+    }
+
+    // producer: push item to the calling thread's lane if there is room left. return false otherwise.
+    bool try_push(T &&item)
+    {
+        return push_(local_lane_(), item, nullptr);
+    }
+
+    // producer: push item to the calling thread's lane, waiting for room up to wait_duration.
+    // return false if the lane was still full by then.
+    bool push_for(T &&item, std::chrono::microseconds wait_duration)
+    {
+        auto deadline = std::chrono::steady_clock::now() + wait_duration;
+        return push_(local_lane_(), item, &deadline);
+    }
+
+    // consumer: pop the oldest item from the consumer's lanes into popped_item.
+    // block until an item is available. return false if terminated and all lanes are drained.
+    bool dequeue(T &popped_item, size_t consumer_idx)
+    {
+        return dequeue_(popped_item, consumer_idx, nullptr);
+    }
+
+    // consumer: like dequeue(), then pop up to max_items that are ready without waiting for more.
+    // return number of items dequeued, or 0 if terminated and all lanes are drained.
+    size_t dequeue_bulk(T *items, size_t max_items, size_t consumer_idx)
+    {
+        if (!dequeue_(items[0], consumer_idx, nullptr))
+        {
+            return 0;
+        }
+        return 1 + dequeue_ready_(items + 1, max_items - 1, *consumers_[consumer_idx]);
+    }
+
+    // consumer: like dequeue_bulk(), waiting up to wait_duration for the first item.
+    // return 0 if none was ready in time, or if terminated and all lanes are drained.
+    size_t dequeue_bulk_for(T *items, size_t max_items, size_t consumer_idx, std::chrono::microseconds wait_duration)
+    {
+        auto deadline = log_clock::now() + std::chrono::duration_cast<log_clock::duration>(wait_duration);
+        if (!dequeue_(items[0], consumer_idx, &deadline))
+        {
+            return 0;
+        }
+        return 1 + dequeue_ready_(items + 1, max_items - 1, *consumers_[consumer_idx]);
+    }
+
+    // push item to the given consumer. it is dequeued right after the items that are in the consumer's lanes now
+    // (which are dequeued without waiting for max_skew).
+    void push_barrier(size_t consumer_idx, T &&item)
+    {
+        consumer &c = *consumers_[consumer_idx];
+        {
+            std::lock_guard<std::mutex> lock(c.mutex);
+            c.barriers.push_back(std::move(item));
+            c.has_barrier.store(true, std::memory_order_release);
+        }
+        c.cv.notify_all();
+    }
+
+    // wake all consumers. they drain their lanes (ignoring max_skew) and return false from dequeue().
+    void terminate()
+    {
+        terminate_.store(true, std::memory_order_release);
+        for (auto &c : consumers_)
+        {
+            {
+                std::lock_guard<std::mutex> lock(c->mutex);
+            }
+            c->cv.notify_all();
+        }
+    }
+
+    // approximate number of items in all lanes
+    size_t size()
+    {
+        size_t total = 0;
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        for (auto &c : consumers_)
+        {
+            for (auto &l : c->registered)
+            {
+                total += l->q.size();
+            }
+        }
+        return total;
+    }
+
+    // approximate number of items in the lanes of the given consumer
+    size_t size(size_t consumer_idx)
+    {
+        size_t total = 0;
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        for (auto &l : consumers_[consumer_idx]->registered)
+        {
+            total += l->q.size();
+        }
+        return total;
+    }
+
+    size_t overrun_counter()
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        size_t total = reclaimed_overrun_counter_;
+        for (auto &c : consumers_)
+        {
+            for (auto &l : c->registered)
+            {
+                total += l->overrun_counter.load(std::memory_order_relaxed);
+            }
+        }
+        return total;
+    }
+
+    void reset_overrun_counter()
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        reclaimed_overrun_counter_ = 0;
+        for (auto &c : consumers_)
+        {
+            for (auto &l : c->registered)
+            {
+                l->overrun_counter.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct lane
+    {
+        lane(size_t lane_size, size_t consumer)
+            : q(lane_size)
+            , consumer_idx(consumer)
+        {}
+
+        spsc_queue<T> q;
+        size_t consumer_idx;
+        std::atomic<size_t> overrun_counter{0};
+        std::atomic<bool> closed{false};   // producer thread exited
+        std::atomic<bool> orphaned{false}; // owning thread_lanes destroyed
+        size_t barrier_left = 0;           // owned by the consumer: items to pop before the armed barrier
+    };
+    using lane_ptr = std::shared_ptr<lane>;
+
+    struct consumer
+    {
+        // protected by registry_mutex_
+        std::vector<lane_ptr> registered;
+        std::atomic<size_t> version{0};
+
+        // owned by the consumer thread
+        std::vector<lane_ptr> lanes;
+        size_t seen_version = 0;
+
+        // barriers pushed by push_barrier(), protected by mutex
+        std::vector<T> barriers;
+        std::atomic<bool> has_barrier{false};
+
+        // owned by the consumer thread: the barrier being waited for
+        T barrier;
+        bool barrier_armed = false;
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::atomic<bool> sleeping{false};
+    };
+
+    // lanes of the calling thread, one per thread_lanes instance (by id).
+    // closes them when the thread exits.
+    struct local_lanes
+    {
+        std::vector<std::pair<size_t, lane_ptr>> lanes;
+        ~local_lanes()
+        {
+            for (auto &l : lanes)
+            {
+                l.second->closed.store(true, std::memory_order_release);
+            }
+        }
+    };
+
+    static size_t next_id_()
+    {
+        static std::atomic<size_t> id_counter{0};
+        return ++id_counter;
+    }
+
+    lane &local_lane_()
+    {
+#ifdef SPDLOG_NO_TLS
+        // not reached: thread_pool rejects the thread_lanes mode without thread local storage
+        throw_spdlog_ex("spdlog::thread_lanes: thread local storage is disabled (SPDLOG_NO_TLS)");
+#else
+        static thread_local local_lanes local;
+        static thread_local std::pair<size_t, lane *> last{0, nullptr};
+        if (last.first == id_)
+        {
+            return *last.second;
+        }
+        for (auto &l : local.lanes)
+        {
+            if (l.first == id_)
+            {
+                last = {id_, l.second.get()};
+                return *last.second;
+            }
+        }
+        return register_lane_(local, last);
+#endif
+    }
+
+    lane &register_lane_(local_lanes &local, std::pair<size_t, lane *> &last)
+    {
+        // drop lanes of destroyed thread_lanes instances
+        for (auto it = local.lanes.begin(); it != local.lanes.end();)
+        {
+            it = it->second->orphaned.load(std::memory_order_relaxed) ? local.lanes.erase(it) : std::next(it);
+        }
+
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        auto consumer_idx = next_consumer_++ % consumers_.size();
+        auto new_lane = std::make_shared<lane>(lane_size_, consumer_idx);
+        consumer &c = *consumers_[consumer_idx];
+        c.registered.push_back(new_lane);
+        c.version.fetch_add(1, std::memory_order_release);
+        local.lanes.emplace_back(id_, new_lane);
+        last = {id_, new_lane.get()};
+        return *new_lane;
+    }
+
+    // consumer: pop the oldest item, sleeping until deadline at most if given.
+    // return false if the deadline passed, or if terminated and all lanes are drained.
+    bool dequeue_(T &popped_item, size_t consumer_idx, const log_clock::time_point *deadline)
+    {
+        consumer &c = *consumers_[consumer_idx];
+        for (unsigned attempt = 0;; attempt++)
+        {
+            refresh_(c);
+            arm_barrier_(c);
+            if (pop_barrier_(c, popped_item))
+            {
+                return true;
+            }
+            lane *picked = nullptr;
+            log_clock::time_point release_time;
+            switch (pick_(c, picked, release_time))
+            {
+            case pick_result::item:
+                pop_(*picked, popped_item);
+                return true;
+            case pick_result::hold:
+                if (deadline)
+                {
+                    if (log_clock::now() >= *deadline)
+                    {
+                        return false;
+                    }
+                    release_time = (std::min)(release_time, *deadline);
+                }
+                park_(c, &release_time);
+                break;
+            case pick_result::empty:
+                if (terminate_.load(std::memory_order_acquire))
+                {
+                    return false;
+                }
+                if (deadline && log_clock::now() >= *deadline)
+                {
+                    return false;
+                }
+                if (!wait_.backoff(attempt))
+                {
+                    park_(c, nullptr, deadline);
+                    attempt = 0;
+                }
+                break;
+            }
+        }
+    }
+
+    // consumer: pop up to max_items that are ready without waiting for more. return number of items popped.
+    size_t dequeue_ready_(T *items, size_t max_items, consumer &c)
+    {
+        size_t n = 0;
+        lane *picked = nullptr;
+        log_clock::time_point release_time;
+        while (n < max_items)
+        {
+            if (pop_barrier_(c, items[n]))
+            {
+                n++;
+            }
+            else if (pick_(c, picked, release_time) == pick_result::item)
+            {
+                pop_(*picked, items[n++]);
+            }
+            else
+            {
+                break;
+            }
+        }
+        return n;
+    }
+
+    // consumer: pick up newly registered lanes and reclaim drained lanes of exited threads
+    void refresh_(consumer &c)
+    {
+        bool reclaim = false;
+        for (auto &l : c.lanes)
+        {
+            if (l->closed.load(std::memory_order_acquire) && l->q.empty())
+            {
+                reclaim = true;
+                break;
+            }
+        }
+
+        if (!reclaim && c.version.load(std::memory_order_acquire) == c.seen_version)
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        if (reclaim)
+        {
+            auto &reg = c.registered;
+            for (auto it = reg.begin(); it != reg.end();)
+            {
+                lane &l = **it;
+                if (l.closed.load(std::memory_order_acquire) && l.q.empty())
+                {
+                    reclaimed_overrun_counter_ += l.overrun_counter.load(std::memory_order_relaxed);
+                    it = reg.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+            c.version.fetch_add(1, std::memory_order_relaxed);
+        }
+        c.lanes = c.registered;
+        c.seen_version = c.version.load(std::memory_order_relaxed);
+    }
+
+    enum class pick_result
+    {
+        item,  // picked lane holds the oldest item, ready to pop
+        hold,  // oldest item must wait until release_time for older items from idle lanes
+        empty, // no items at all
+    };
+
+    // consumer: find the lane with the oldest front item.
+    // an idle lane might still deliver an item older than the oldest we have,
+    // so unless all lanes are busy it is held back until max_skew has passed.
+    pick_result pick_(consumer &c, lane *&picked, log_clock::time_point &release_time)
+    {
+        bool all_busy = true;
+        T *oldest = nullptr;
+        for (auto &l : c.lanes)
+        {
+            T *item = l->q.front();
+            if (item == nullptr)
+            {
+                all_busy = false;
+            }
+            else if (oldest == nullptr || item->time < oldest->time)
+            {
+                oldest = item;
+                picked = l.get();
+            }
+        }
+
+        if (oldest == nullptr)
+        {
+            return pick_result::empty;
+        }
+        if (all_busy || max_skew_.count() == 0 || terminate_.load(std::memory_order_acquire))
+        {
+            return pick_result::item;
+        }
+        release_time = oldest->time + std::chrono::duration_cast<log_clock::duration>(max_skew_);
+        return log_clock::now() >= release_time ? pick_result::item : pick_result::hold;
+    }
+
+    // producer: push item to lane l. if full, wait for room until deadline (don't wait if null).
+    bool push_(lane &l, T &item, const std::chrono::steady_clock::time_point *deadline)
+    {
+        for (unsigned attempt = 0; !l.q.try_push(item); attempt++)
+        {
+            if (deadline == nullptr)
+            {
+                return false;
+            }
+            if (!spin_backoff(attempt))
+            {
+                auto now = std::chrono::steady_clock::now();
+                if (now >= *deadline)
+                {
+                    return false;
+                }
+                wake_(*consumers_[l.consumer_idx]);
+                std::this_thread::sleep_for((std::min)(std::chrono::steady_clock::duration(std::chrono::microseconds(100)), *deadline - now));
+            }
+        }
+        wake_(*consumers_[l.consumer_idx]);
+        return true;
+    }
+
+    static void pop_(lane &l, T &popped_item)
+    {
+        popped_item = std::move(*l.q.front());
+        l.q.pop_front();
+        if (l.barrier_left > 0)
+        {
+            l.barrier_left--;
+        }
+    }
+
+    // consumer: take the next pushed barrier, and count the items it has to wait for in each lane.
+    void arm_barrier_(consumer &c)
+    {
+        if (c.barrier_armed || !c.has_barrier.load(std::memory_order_acquire))
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(c.mutex);
+            c.barrier = std::move(c.barriers.front());
+            c.barriers.erase(c.barriers.begin());
+            c.has_barrier.store(!c.barriers.empty(), std::memory_order_relaxed);
+        }
+        // lanes registered before the barrier was pushed
+        refresh_(c);
+        for (auto &l : c.lanes)
+        {
+            l->barrier_left = l->q.size();
+        }
+        c.barrier_armed = true;
+    }
+
+    // consumer: while a barrier is armed, pop the oldest of the items before it, then the barrier itself.
+    bool pop_barrier_(consumer &c, T &popped_item)
+    {
+        if (!c.barrier_armed)
+        {
+            return false;
+        }
+        lane *oldest = nullptr;
+        for (auto &l : c.lanes)
+        {
+            if (l->barrier_left > 0 && (oldest == nullptr || l->q.front()->time < oldest->q.front()->time))
+            {
+                oldest = l.get();
+            }
+        }
+        if (oldest != nullptr)
+        {
+            pop_(*oldest, popped_item);
+            return true;
+        }
+        popped_item = std::move(c.barrier);
+        c.barrier_armed = false;
+        return true;
+    }
+
+    // consumer: sleep until a producer pushes, a lane is registered, a barrier is pushed or terminate() is called.
+    // with a release_time, sleep until then at most. The lanes are not re-checked in this case,
+    // since they hold the item waiting for the release time. a missed wakeup costs max_skew at most.
+    // otherwise sleep until deadline at most, if given.
+    // the fence pairs with the one in wake_(): either the producer sees sleeping == true,
+    // or we see its item when re-checking.
+    void park_(consumer &c, const log_clock::time_point *release_time, const log_clock::time_point *deadline = nullptr)
+    {
+        std::unique_lock<std::mutex> lock(c.mutex);
+        c.sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (release_time)
+        {
+            if (!has_news_(c))
+            {
+                c.cv.wait_until(lock, *release_time);
+            }
+        }
+        else if (!has_news_(c) && !has_items_(c))
+        {
+            if (deadline)
+            {
+                c.cv.wait_until(lock, *deadline);
+            }
+            else
+            {
+                c.cv.wait(lock);
+            }
+        }
+        c.sleeping.store(false, std::memory_order_relaxed);
+    }
+
+    bool has_news_(consumer &c)
+    {
+        return terminate_.load(std::memory_order_acquire) || c.has_barrier.load(std::memory_order_acquire) ||
+               c.version.load(std::memory_order_acquire) != c.seen_version;
+    }
+
+    bool has_items_(consumer &c)
+    {
+        for (auto &l : c.lanes)
+        {
+            // closed lanes need reclaiming
+            if (!l->q.empty() || l->closed.load(std::memory_order_acquire))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void wake_(consumer &c)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (c.sleeping.load(std::memory_order_relaxed))
+        {
+            {
+                std::lock_guard<std::mutex> lock(c.mutex);
+            }
+            c.cv.notify_one();
+        }
+    }
+
+    const size_t id_;
+    const size_t lane_size_;
+    const std::chrono::microseconds max_skew_;
+    const wait_strategy wait_;
+    std::vector<std::unique_ptr<consumer>> consumers_;
+    std::mutex registry_mutex_;
+    size_t next_consumer_ = 0;
+    size_t reclaimed_overrun_counter_ = 0;
+    std::atomic<bool> terminate_{false};
+};
+} // namespace details
+} // namespace spdlog
@@ -9,29 +9,117 @@
 
 #include <spdlog/common.h>
 #include <cassert>
+#include <cmath>
+#include <exception>
 
 namespace spdlog {
 namespace details {
 
-SPDLOG_INLINE thread_pool::thread_pool(
-    size_t q_max_items, size_t threads_n, std::function<void()> on_thread_start, std::function<void()> on_thread_stop)
-    : q_(q_max_items)
+SPDLOG_INLINE thread_pool::thread_pool(const thread_pool_options &options)
+    : batch_size_(options.batch_size)
+    , deferred_formatting_(options.deferred_formatting)
 {
-    if (threads_n == 0 || threads_n > 1000)
+    if (options.threads_n == 0 || options.threads_n > 1000)
     {
         throw_spdlog_ex("spdlog::thread_pool(): invalid threads_n param (valid "
                         "range is 1-1000)");
     }
-    for (size_t i = 0; i < threads_n; i++)
+    if (batch_size_ == 0)
+    {
+        throw_spdlog_ex("spdlog::thread_pool(): batch_size must be greater than zero");
+    }
+    if (options.queue_size == 0)
+    {
+        throw_spdlog_ex("spdlog::thread_pool(): queue_size must be greater than zero");
+    }
+    if (options.priority_lanes && options.queue_mode == async_queue_mode::thread_lanes)
+    {
+        throw_spdlog_ex("spdlog::thread_pool(): priority_lanes are not supported in thread_lanes mode");
+    }
+#ifdef SPDLOG_NO_TLS
+    if (options.queue_mode == async_queue_mode::thread_lanes)
+    {
+        throw_spdlog_ex("spdlog::thread_pool(): thread_lanes mode requires thread local storage (SPDLOG_NO_TLS is defined)");
+    }
+#endif
+    if (options.numa_local_queues && options.worker_cpus.empty())
+    {
+        throw_spdlog_ex("spdlog::thread_pool(): numa_local_queues requires worker_cpus");
+    }
+    if (options.queue_mode == async_queue_mode::thread_lanes)
+    {
+        lanes_ = details::make_unique<thread_lanes<item_type>>(
+            options.lane_size, options.threads_n, options.lanes_max_skew, wait_strategy_(options));
+    }
+    else
+    {
+        create_queues_(options, options.queue_mode == async_queue_mode::sharded ? options.threads_n : 1);
+    }
+    setup_queue_levels_(options);
+    if (options.logger_ref == async_logger_ref::raw_ptr)
+    {
+        exit_ = std::make_shared<thread_pool_exit>();
+    }
+
+    shutdown_loggers_.resize(options.threads_n);
+
+    // the workers report whether their settings could be applied before the constructor returns
+    struct startup_state
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        size_t started = 0;
+        std::string error;
+    } startup;
+
+    for (size_t i = 0; i < options.threads_n; i++)
     {
-        threads_.emplace_back([this, on_thread_start, on_thread_stop] {
-            on_thread_start();
-            this->thread_pool::worker_loop_();
-            on_thread_stop();
+        threads_.emplace_back([this, i, options, &startup] {
+            auto error = configure_worker_(options, i, false);
+            {
+                // notify under the lock: startup is gone as soon as the constructor sees the last worker
+                std::lock_guard<std::mutex> lock(startup.mutex);
+                if (!error.empty() && startup.error.empty())
+                {
+                    startup.error = error;
+                }
+                startup.started++;
+                startup.cv.notify_one();
+            }
+            // a misconfigured worker still serves its queue until the constructor stops the pool
+            if (!error.empty())
+            {
+                this->thread_pool::worker_loop_(i);
+                return;
+            }
+            options.on_thread_start();
+            this->thread_pool::worker_loop_(i);
+            options.on_thread_stop();
         });
     }
+
+    std::unique_lock<std::mutex> lock(startup.mutex);
+    startup.cv.wait(lock, [this, &startup] { return startup.started == threads_.size(); });
+    if (!startup.error.empty())
+    {
+        lock.unlock();
+        stop_workers_();
+        throw_spdlog_ex(startup.error);
+    }
 }
 
+SPDLOG_INLINE thread_pool::thread_pool(
+    size_t q_max_items, size_t threads_n, std::function<void()> on_thread_start, std::function<void()> on_thread_stop)
+    : thread_pool([&] {
+        thread_pool_options options;
+        options.queue_size = q_max_items;
+        options.threads_n = threads_n;
+        options.on_thread_start = std::move(on_thread_start);
+        options.on_thread_stop = std::move(on_thread_stop);
+        return options;
+    }())
+{}
+
 SPDLOG_INLINE thread_pool::thread_pool(size_t q_max_items, size_t threads_n, std::function<void()> on_thread_start)
     : thread_pool(q_max_items, threads_n, on_thread_start, [] {})
 {}
@@ -46,91 +134,820 @@ SPDLOG_INLINE thread_pool::~thread_pool()
 {
     SPDLOG_TRY
     {
-        for (size_t i = 0; i < threads_.size(); i++)
+        if (!stopped_.load(std::memory_order_relaxed))
         {
-            post_async_msg_(async_msg(async_msg_type::terminate), async_overflow_policy::block);
+            stop_workers_();
         }
+    }
+    SPDLOG_CATCH_STD
 
-        for (auto &t : threads_)
+    // loggers being destroyed meanwhile can go now
+    if (exit_)
+    {
         {
-            t.join();
+            std::lock_guard<std::mutex> lock(exit_->mutex);
+            exit_->done = true;
         }
+        exit_->cv.notify_all();
     }
-    SPDLOG_CATCH_STD
 }
 
-void SPDLOG_INLINE thread_pool::post_log(async_logger_ptr &&worker_ptr, const details::log_msg &msg, async_overflow_policy overflow_policy)
+void SPDLOG_INLINE thread_pool::post_log(
+    async_logger_ptr &&worker_ptr, const details::log_msg &msg, async_overflow_policy overflow_policy, deferred_format_fn format_fn)
 {
     async_msg async_m(std::move(worker_ptr), async_msg_type::log, msg);
+    async_m.format_fn = format_fn;
     post_async_msg_(std::move(async_m), overflow_policy);
 }
 
-void SPDLOG_INLINE thread_pool::post_flush(async_logger_ptr &&worker_ptr, async_overflow_policy overflow_policy)
+bool SPDLOG_INLINE thread_pool::post_flush(async_logger_ptr &&worker_ptr, async_overflow_policy overflow_policy)
 {
-    post_async_msg_(async_msg(std::move(worker_ptr), async_msg_type::flush), overflow_policy);
+    async_msg flush_msg(std::move(worker_ptr), async_msg_type::flush);
+    // lanes are merged by time, so the flush request must be ordered after the messages before it
+    flush_msg.time = log_clock::now();
+    return post_async_msg_(std::move(flush_msg), overflow_policy);
+}
+
+void SPDLOG_INLINE thread_pool::post_log(
+    async_logger *worker, const details::log_msg &msg, async_overflow_policy overflow_policy, deferred_format_fn format_fn)
+{
+    async_msg async_m(worker, async_msg_type::log, msg);
+    async_m.format_fn = format_fn;
+    post_async_msg_(std::move(async_m), overflow_policy);
+}
+
+bool SPDLOG_INLINE thread_pool::post_flush(async_logger *worker, async_overflow_policy overflow_policy)
+{
+    async_msg flush_msg(worker, async_msg_type::flush);
+    flush_msg.time = log_clock::now();
+    return post_async_msg_(std::move(flush_msg), overflow_policy);
+}
+
+bool SPDLOG_INLINE thread_pool::deferred_formatting() const
+{
+    return deferred_formatting_;
+}
+
+std::shared_ptr<thread_pool_exit> SPDLOG_INLINE thread_pool::exit_state()
+{
+    return exit_;
+}
+
+void SPDLOG_INLINE thread_pool::drain()
+{
+    std::lock_guard<std::mutex> drain_lock(drain_mutex_);
+    if (stopped_.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    for (size_t i = 0; i < threads_.size(); i++)
+    {
+        post_control_(i, async_msg(async_msg_type::drain));
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(barrier_mutex_);
+        barrier_cv_.wait(lock, [this] { return barrier_arrived_ == threads_.size(); });
+        barrier_arrived_ = 0;
+        barrier_generation_++;
+    }
+    barrier_cv_.notify_all();
+}
+
+size_t SPDLOG_INLINE thread_pool::shutdown(std::chrono::milliseconds timeout)
+{
+    std::lock_guard<std::mutex> drain_lock(drain_mutex_);
+    if (stopped_.load(std::memory_order_relaxed))
+    {
+        return 0;
+    }
+    shutdown_deadline_ = std::chrono::steady_clock::now() + timeout;
+    shutting_down_.store(true, std::memory_order_release);
+
+    stop_workers_();
+    stopped_.store(true, std::memory_order_relaxed);
+    auto dropped = shutdown_dropped_.load(std::memory_order_relaxed) + drop_leftovers_();
+    flush_shutdown_loggers_();
+
+    // loggers being destroyed meanwhile can go now
+    if (exit_)
+    {
+        {
+            std::lock_guard<std::mutex> lock(exit_->mutex);
+            exit_->done = true;
+        }
+        exit_->cv.notify_all();
+    }
+    return dropped;
 }
 
 size_t SPDLOG_INLINE thread_pool::overrun_counter()
 {
-    return q_.overrun_counter();
+    size_t total = 0;
+    for (size_t i = 0; i < shards_n(); i++)
+    {
+        total += overrun_counter(i);
+    }
+    return total;
 }
 
 void SPDLOG_INLINE thread_pool::reset_overrun_counter()
 {
-    q_.reset_overrun_counter();
+    if (lanes_)
+    {
+        lanes_->reset_overrun_counter();
+        return;
+    }
+    for (auto &q : queues_)
+    {
+        q->reset_overrun_counter();
+    }
+    for (auto &q : priority_queues_)
+    {
+        q->reset_overrun_counter();
+    }
 }
 
 size_t SPDLOG_INLINE thread_pool::queue_size()
 {
-    return q_.size();
+    size_t total = 0;
+    for (size_t i = 0; i < shards_n(); i++)
+    {
+        total += queue_size(i);
+    }
+    return total;
+}
+
+size_t SPDLOG_INLINE thread_pool::queue_level(size_t shard) const
+{
+    return queue_levels_.empty() ? 0 : queue_levels_.at(shard)->level.load(std::memory_order_relaxed);
+}
+
+size_t SPDLOG_INLINE thread_pool::high_water_mark(size_t shard) const
+{
+    return queue_levels_.empty() ? 0 : queue_levels_.at(shard)->high_water.load(std::memory_order_relaxed);
+}
+
+void SPDLOG_INLINE thread_pool::reset_high_water_mark()
+{
+    for (auto &state : queue_levels_)
+    {
+        state->high_water.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t SPDLOG_INLINE thread_pool::shards_n() const
+{
+    return lanes_ ? 1 : queues_n_();
+}
+
+size_t SPDLOG_INLINE thread_pool::overrun_counter(size_t shard)
+{
+    if (lanes_)
+    {
+        return lanes_->overrun_counter();
+    }
+    return priority_queues_.empty() ? queues_.at(shard)->overrun_counter() : priority_queues_.at(shard)->overrun_counter();
+}
+
+size_t SPDLOG_INLINE thread_pool::queue_size(size_t shard)
+{
+    if (lanes_)
+    {
+        return lanes_->size();
+    }
+    return priority_queues_.empty() ? queues_.at(shard)->size() : priority_queues_.at(shard)->size();
+}
+
+std::string SPDLOG_INLINE thread_pool::configure_worker_(const thread_pool_options &options, size_t worker_idx, bool affinity_only)
+{
+    if (!options.worker_cpus.empty() && !os::set_thread_affinity(options.worker_cpus[worker_idx % options.worker_cpus.size()]))
+    {
+        return "spdlog::thread_pool(): failed setting cpu affinity of worker " + std::to_string(worker_idx);
+    }
+    if (affinity_only)
+    {
+        return {};
+    }
+    if ((options.worker_nice != 0 || options.worker_sched_batch) &&
+        !os::set_thread_priority(options.worker_nice, options.worker_sched_batch))
+    {
+        return "spdlog::thread_pool(): failed setting scheduling priority of worker " + std::to_string(worker_idx);
+    }
+    // naming is best effort
+    if (!options.thread_name.empty())
+    {
+        os::set_thread_name(options.thread_name + std::to_string(worker_idx));
+    }
+    return {};
+}
+
+wait_strategy SPDLOG_INLINE thread_pool::wait_strategy_(const thread_pool_options &options)
+{
+    wait_strategy wait;
+    wait.kind = options.wait_strategy;
+    wait.spins = options.wait_spins;
+    wait.yields = options.wait_yields;
+    return wait;
+}
+
+void SPDLOG_INLINE thread_pool::create_queues_(const thread_pool_options &options, size_t queues_n)
+{
+    auto create_queue = [this, &options] {
+        if (options.priority_lanes)
+        {
+            priority_queues_.push_back(details::make_unique<priority_q_type>(
+                options.queue_size, async_msg_band{options.priority_level}, options.priority_max_streak, wait_strategy_(options)));
+        }
+        else
+        {
+            queues_.push_back(details::make_unique<q_type>(options.queue_size, wait_strategy_(options)));
+        }
+    };
+
+    for (size_t i = 0; i < queues_n; i++)
+    {
+        if (!options.numa_local_queues)
+        {
+            create_queue();
+            continue;
+        }
+
+        // the queue constructor touches all of its memory, so it gets placed on the node of the allocating thread.
+        // a shared queue is placed with the first worker.
+        // an exception escaping the thread would terminate: rethrow it here instead
+        std::string error;
+        std::exception_ptr failure;
+        std::thread([&options, &create_queue, &error, &failure, i] {
+            error = configure_worker_(options, i, true);
+            if (error.empty())
+            {
+                SPDLOG_TRY
+                {
+                    create_queue();
+                }
+#ifndef SPDLOG_NO_EXCEPTIONS
+                catch (...)
+                {
+                    failure = std::current_exception();
+                }
+#endif
+            }
+        }).join();
+        if (failure)
+        {
+            std::rethrow_exception(failure);
+        }
+        if (!error.empty())
+        {
+            throw_spdlog_ex(error);
+        }
+    }
+}
+
+void SPDLOG_INLINE thread_pool::stop_workers_()
+{
+    if (lanes_)
+    {
+        lanes_->terminate();
+    }
+    else
+    {
+        for (size_t i = 0; i < threads_.size(); i++)
+        {
+            post_control_(i, async_msg(async_msg_type::terminate));
+        }
+    }
+
+    for (auto &t : threads_)
+    {
+        t.join();
+    }
+    threads_.clear();
+}
+
+// shutdown(): count and discard the messages posted after the workers got their terminate message.
+// (in thread_lanes mode the workers drain the lanes before exiting)
+size_t SPDLOG_INLINE thread_pool::drop_leftovers_()
+{
+    size_t dropped = 0;
+    for (auto &q : queues_)
+    {
+        dropped += drop_leftovers_(*q);
+    }
+    for (auto &q : priority_queues_)
+    {
+        dropped += drop_leftovers_(*q);
+    }
+    return dropped;
+}
+
+template<typename Q>
+size_t thread_pool::drop_leftovers_(Q &q)
+{
+    size_t dropped = 0;
+    async_msg leftover;
+    while (q.dequeue_for(leftover, std::chrono::milliseconds::zero()))
+    {
+        if (leftover.msg_type == async_msg_type::log)
+        {
+            leftover.worker->drop_counter_.fetch_add(1, std::memory_order_relaxed);
+            dropped++;
+        }
+        else if (leftover.msg_type == async_msg_type::flush)
+        {
+            leftover.worker->backend_flush_request_(true);
+        }
+        leftover.worker_ptr.reset();
+    }
+    return dropped;
+}
+
+// shutdown(): flush the sinks of the loggers the workers processed messages of, each sink once
+void SPDLOG_INLINE thread_pool::flush_shutdown_loggers_()
+{
+    std::vector<sink_ptr> sinks;
+    for (auto &worker_loggers : shutdown_loggers_)
+    {
+        for (auto &logger : worker_loggers)
+        {
+            for (auto &sink : logger.first->sinks())
+            {
+                if (std::find(sinks.begin(), sinks.end(), sink) == sinks.end())
+                {
+                    sinks.push_back(sink);
+                }
+            }
+        }
+        worker_loggers.clear();
+    }
+    for (auto &sink : sinks)
+    {
+        SPDLOG_TRY
+        {
+            sink->flush();
+        }
+        SPDLOG_CATCH_STD
+    }
+}
+
+void SPDLOG_INLINE thread_pool::setup_queue_levels_(const thread_pool_options &options)
+{
+    if (options.queue_level_thresholds.empty())
+    {
+        return;
+    }
+    if (lanes_)
+    {
+        throw_spdlog_ex("spdlog::thread_pool(): queue_level_thresholds are not supported in thread_lanes mode");
+    }
+    for (auto threshold : options.queue_level_thresholds)
+    {
+        if (!(threshold > 0 && threshold <= 1))
+        {
+            throw_spdlog_ex("spdlog::thread_pool(): queue_level_thresholds must be in the range (0, 1]");
+        }
+        auto depth = static_cast<size_t>(std::ceil(threshold * static_cast<double>(options.queue_size)));
+        level_depths_.push_back((std::max)(depth, size_t(1)));
+    }
+    std::sort(level_depths_.begin(), level_depths_.end());
+    for (size_t i = 0; i < queues_n_(); i++)
+    {
+        queue_levels_.push_back(details::make_unique<queue_level_state>());
+    }
+    on_queue_level_ = options.on_queue_level;
+}
+
+// called after each post, and after each dequeue by the workers
+void SPDLOG_INLINE thread_pool::update_queue_level_(size_t shard)
+{
+    auto depth = queue_size(shard);
+    auto &state = *queue_levels_[shard];
+    auto high_water = state.high_water.load(std::memory_order_relaxed);
+    while (depth > high_water && !state.high_water.compare_exchange_weak(high_water, depth, std::memory_order_relaxed)) {}
+
+    auto level = static_cast<size_t>(std::upper_bound(level_depths_.begin(), level_depths_.end(), depth) - level_depths_.begin());
+    auto old_level = state.level.load(std::memory_order_relaxed);
+    if (level != old_level && state.level.compare_exchange_strong(old_level, level, std::memory_order_relaxed) && on_queue_level_)
+    {
+        SPDLOG_TRY
+        {
+            on_queue_level_(shard, level);
+        }
+        SPDLOG_CATCH_STD
+    }
+}
+
+bool SPDLOG_INLINE thread_pool::post_async_msg_(async_msg &&new_msg, async_overflow_policy overflow_policy)
+{
+    async_logger *worker = new_msg.worker;
+    bool is_log = new_msg.msg_type == async_msg_type::log;
+    if (shutting_down_.load(std::memory_order_relaxed))
+    {
+        if (is_log)
+        {
+            worker->drop_counter_.fetch_add(1, std::memory_order_relaxed);
+            shutdown_dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return false;
+    }
+    bool posted = true;
+    bool dropped_as_overrun = false;
+    if (lanes_)
+    {
+        switch (overflow_policy)
+        {
+        case async_overflow_policy::block:
+            posted = lanes_->push(std::move(new_msg), true);
+            break;
+        case async_overflow_policy::overrun_oldest:
+            // producers can't take items from their lane: the new item is dropped and counted as overrun
+            posted = lanes_->push(std::move(new_msg), false);
+            dropped_as_overrun = true;
+            break;
+        case async_overflow_policy::discard_new:
+            posted = lanes_->try_push(std::move(new_msg));
+            break;
+        case async_overflow_policy::block_for:
+            posted = lanes_->push_for(std::move(new_msg), worker->overflow_timeout());
+            break;
+        }
+    }
+    else
+    {
+        // in sharded mode, the logger's shard
+        auto queues_n = queues_n_();
+        size_t shard = queues_n == 1 ? 0 : worker->shard_.load(std::memory_order_relaxed) % queues_n;
+        if (priority_queues_.empty())
+        {
+            posted = enqueue_(*queues_[shard], std::move(new_msg), overflow_policy);
+        }
+        else
+        {
+            posted = enqueue_(*priority_queues_[shard], std::move(new_msg), overflow_policy);
+        }
+        if (!queue_levels_.empty())
+        {
+            update_queue_level_(shard);
+        }
+    }
+
+    if (!posted && is_log)
+    {
+        auto &counter = dropped_as_overrun ? worker->overrun_counter_ : worker->drop_counter_;
+        counter.fetch_add(1, std::memory_order_relaxed);
+    }
+    return posted;
+}
+
+template<typename Q>
+bool thread_pool::enqueue_(Q &q, async_msg &&new_msg, async_overflow_policy overflow_policy)
+{
+    switch (overflow_policy)
+    {
+    case async_overflow_policy::block:
+        q.enqueue(std::move(new_msg));
+        return true;
+    case async_overflow_policy::overrun_oldest:
+        // drain and terminate messages are never overrun: the threads waiting for them would wait forever
+        q.enqueue_nowait(std::move(new_msg), [](const async_msg &lost) {
+            if (lost.msg_type == async_msg_type::log)
+            {
+                lost.worker->overrun_counter_.fetch_add(1, std::memory_order_relaxed);
+            }
+            else if (lost.msg_type == async_msg_type::flush)
+            {
+                lost.worker->backend_flush_request_(true);
+            }
+            return lost.msg_type == async_msg_type::log || lost.msg_type == async_msg_type::flush;
+        });
+        return true;
+    case async_overflow_policy::discard_new:
+        return q.try_enqueue(std::move(new_msg));
+    case async_overflow_policy::block_for: {
+        auto timeout = new_msg.worker->overflow_timeout();
+        return q.enqueue_for(std::move(new_msg), timeout);
+    }
+    }
+    return true;
 }
 
-void SPDLOG_INLINE thread_pool::post_async_msg_(async_msg &&new_msg, async_overflow_policy overflow_policy)
+void SPDLOG_INLINE thread_pool::post_control_(size_t worker_idx, async_msg &&msg)
 {
-    if (overflow_policy == async_overflow_policy::block)
+    if (lanes_)
     {
-        q_.enqueue(std::move(new_msg));
+        lanes_->push_barrier(worker_idx, std::move(msg));
+    }
+    else if (priority_queues_.empty())
+    {
+        queues_[worker_queue_idx_(worker_idx)]->enqueue(std::move(msg));
     }
     else
     {
-        q_.enqueue_nowait(std::move(new_msg));
+        priority_queues_[worker_queue_idx_(worker_idx)]->enqueue(std::move(msg));
     }
 }
 
-void SPDLOG_INLINE thread_pool::worker_loop_()
+size_t SPDLOG_INLINE thread_pool::queues_n_() const
 {
-    while (process_next_msg_()) {}
+    return priority_queues_.empty() ? queues_.size() : priority_queues_.size();
 }
 
-// process next message in the queue
+size_t SPDLOG_INLINE thread_pool::worker_queue_idx_(size_t worker_idx) const
+{
+    return worker_idx % queues_n_();
+}
+
+void SPDLOG_INLINE thread_pool::worker_loop_(size_t worker_idx)
+{
+    worker_state state;
+    state.batch.resize(batch_size_);
+    state.run.reserve(batch_size_);
+    while (process_next_msg_(worker_idx, state)) {}
+}
+
+// process next batch of messages in the queue
 // return true if this thread should still be active (while no terminate msg
 // was received)
-bool SPDLOG_INLINE thread_pool::process_next_msg_()
+bool SPDLOG_INLINE thread_pool::process_next_msg_(size_t worker_idx, worker_state &state)
 {
-    async_msg incoming_async_msg;
-    q_.dequeue(incoming_async_msg);
+    auto &batch = state.batch;
+    auto &run = state.run;
+    auto &formatted = state.formatted;
+    // with pending flushes, don't sleep until the next message: nothing might come, and the flushes run
+    // once the queue is found empty. a batch of zero messages runs them.
+    const bool poll = !state.deferred_flushes.empty();
+    const auto poll_interval = std::chrono::milliseconds(1);
+    size_t count;
+    if (lanes_)
+    {
+        if (poll)
+        {
+            count = lanes_->dequeue_bulk_for(batch.data(), batch.size(), worker_idx, poll_interval);
+        }
+        else
+        {
+            count = lanes_->dequeue_bulk(batch.data(), batch.size(), worker_idx);
+            if (count == 0)
+            {
+                return false;
+            }
+        }
+    }
+    else
+    {
+        auto queue_idx = worker_queue_idx_(worker_idx);
+        if (priority_queues_.empty())
+        {
+            count = poll ? queues_[queue_idx]->dequeue_bulk_for(batch.data(), batch.size(), poll_interval)
+                         : queues_[queue_idx]->dequeue_bulk(batch.data(), batch.size());
+        }
+        else
+        {
+            count = poll ? priority_queues_[queue_idx]->dequeue_bulk_for(batch.data(), batch.size(), poll_interval)
+                         : priority_queues_[queue_idx]->dequeue_bulk(batch.data(), batch.size());
+        }
+        if (!queue_levels_.empty())
+        {
+            update_queue_level_(queue_idx);
+        }
+    }
+    state.dequeued += count;
 
-    switch (incoming_async_msg.msg_type)
+    // past the shutdown deadline, drop log messages and skip flushes.
+    // while shutting down, messages are processed one by one, so the deadline is checked before each of them.
+    bool shutting_down = false;
+    bool discard = false;
+    auto check_shutdown = [this, &shutting_down, &discard] {
+        if (!shutting_down)
+        {
+            shutting_down = shutting_down_.load(std::memory_order_acquire);
+        }
+        if (shutting_down && !discard)
+        {
+            discard = std::chrono::steady_clock::now() >= shutdown_deadline_;
+        }
+    };
+
+    bool active = true;
+    bool drained = false;
+    size_t other_terminates = 0;
+    for (size_t i = 0; i < count; i++)
     {
-    case async_msg_type::log: {
-        incoming_async_msg.worker_ptr->backend_sink_it_(incoming_async_msg);
-        return true;
+        async_msg &incoming_async_msg = batch[i];
+        switch (incoming_async_msg.msg_type)
+        {
+        case async_msg_type::log: {
+            check_shutdown();
+            // hand consecutive messages of the same logger over at once
+            size_t run_end = i + 1;
+            while (run_end < count && (!shutting_down || discard) && batch[run_end].msg_type == async_msg_type::log &&
+                   batch[run_end].worker == incoming_async_msg.worker)
+            {
+                run_end++;
+            }
+            if (shutting_down)
+            {
+                record_shutdown_logger_(worker_idx, incoming_async_msg);
+            }
+            if (discard)
+            {
+                incoming_async_msg.worker->drop_counter_.fetch_add(run_end - i, std::memory_order_relaxed);
+                shutdown_dropped_.fetch_add(run_end - i, std::memory_order_relaxed);
+                i = run_end - 1;
+                break;
+            }
+            // messages with deferred formatting get formatted in place. those that fail are skipped.
+            // if all sinks of the logger store the serialized arguments, they get them as they are.
+            run.clear();
+            bool keep_serialized = incoming_async_msg.worker->serialized_sinks_() == incoming_async_msg.worker->sinks_.size();
+            for (size_t j = i; j < run_end; j++)
+            {
+                if (batch[j].format_fn != nullptr && keep_serialized)
+                {
+                    run.push_back(batch[j]);
+                    run.back().serialized = batch[j].payload;
+                    run.back().payload = string_view_t{};
+                    continue;
+                }
+                if (batch[j].format_fn != nullptr)
+                {
+                    incoming_async_msg.worker->backend_format_(batch[j], formatted);
+                }
+                if (batch[j].format_fn == nullptr)
+                {
+                    run.push_back(batch[j]);
+                }
+            }
+            if (!run.empty())
+            {
+                // sinks with the same format share the formatted text (see formatter::format_shared())
+                if (incoming_async_msg.worker->sinks_.size() > 1)
+                {
+                    if (state.run_caches.size() < run.size())
+                    {
+                        state.run_caches.resize(run.size());
+                    }
+                    for (size_t j = 0; j < run.size(); j++)
+                    {
+                        state.run_caches[j].reset();
+                        run[j].fmt_cache = &state.run_caches[j];
+                    }
+                }
+                incoming_async_msg.worker->backend_sink_batch_(run.data(), run.size());
+            }
+            i = run_end - 1;
+            break;
+        }
+        case async_msg_type::flush: {
+            check_shutdown();
+            // requests merged into this one meanwhile get flushed later, after the messages logged before them
+            if (incoming_async_msg.worker->backend_flush_request_(discard))
+            {
+                state.merged_flushes.push_back(deferred_flush{incoming_async_msg.worker, incoming_async_msg.worker_ptr, 0});
+            }
+            break;
+        }
+
+        case async_msg_type::drain: {
+            // one drain message is posted per thread (only a shared queue can deliver several to one thread).
+            // give back the ones meant for other threads before waiting for them.
+            if (!drained)
+            {
+                drained = true;
+                for (size_t j = i + 1; j < count; j++)
+                {
+                    if (batch[j].msg_type == async_msg_type::drain)
+                    {
+                        post_control_(worker_idx, async_msg(async_msg_type::drain));
+                    }
+                }
+                // in raw_ptr mode, the logger waiting for the drain must not be referred to afterwards
+                run_deferred_flushes_(worker_idx, state, true, discard);
+                arrive_at_barrier_();
+            }
+            break;
+        }
+
+        case async_msg_type::terminate: {
+            // one terminate message is posted per thread. give back the ones meant for other threads.
+            if (active)
+            {
+                active = false;
+            }
+            else
+            {
+                other_terminates++;
+            }
+            break;
+        }
+
+        default: {
+            assert(false);
+        }
+        }
     }
-    case async_msg_type::flush: {
-        incoming_async_msg.worker_ptr->backend_flush_();
-        return true;
+
+    // don't keep the loggers alive until the slots get reused
+    for (size_t i = 0; i < count; i++)
+    {
+        batch[i].worker_ptr.reset();
     }
 
-    case async_msg_type::terminate: {
-        return false;
+    if (!state.merged_flushes.empty() || !state.deferred_flushes.empty())
+    {
+        run_deferred_flushes_(worker_idx, state, !active, discard);
+        if (!active)
+        {
+            // merged into again meanwhile: the messages before terminate were processed, so flush once
+            // more. nothing would run the requests merged after that.
+            for (auto &flush : state.deferred_flushes)
+            {
+                if (flush.worker->backend_flush_request_(discard))
+                {
+                    flush.worker->backend_flush_request_(true);
+                }
+            }
+            state.deferred_flushes.clear();
+        }
     }
 
-    default: {
-        assert(false);
+    for (size_t i = 0; i < other_terminates; i++)
+    {
+        post_control_(worker_idx, async_msg(async_msg_type::terminate));
     }
+    return active;
+}
+
+void SPDLOG_INLINE thread_pool::run_deferred_flushes_(size_t worker_idx, worker_state &state, bool settle, bool discard)
+{
+    // the messages this worker is going to dequeue: its own lanes, or its queue
+    auto pending = [this, worker_idx] { return lanes_ ? lanes_->size(worker_idx) : queue_size(worker_queue_idx_(worker_idx)); };
+    // read after the requests were found merged
+    auto depth = pending();
+    for (auto &flush : state.merged_flushes)
+    {
+        flush.due = state.dequeued + depth;
+        state.deferred_flushes.push_back(std::move(flush));
     }
+    state.merged_flushes.clear();
 
-    return true;
+    // an empty queue means the messages were dequeued (by this worker or others).
+    // if other workers of a shared queue empty it right after this check, the flush waits for the next poll.
+    bool run_all = settle || discard || depth == 0;
+    auto &deferred = state.deferred_flushes;
+    size_t kept = 0;
+    for (size_t i = 0; i < deferred.size(); i++)
+    {
+        auto &flush = deferred[i];
+        if (run_all || state.dequeued >= flush.due)
+        {
+            bool merged = flush.worker->backend_flush_request_(discard);
+            if (merged && settle && !flush.worker_ptr)
+            {
+                // raw_ptr mode: the logger might be waiting for the drain. it gets no new requests then,
+                // so a second run covers all of them.
+                merged = flush.worker->backend_flush_request_(discard);
+            }
+            if (!merged)
+            {
+                continue;
+            }
+            flush.due = state.dequeued + pending();
+        }
+        if (kept != i)
+        {
+            deferred[kept] = std::move(flush);
+        }
+        kept++;
+    }
+    deferred.erase(deferred.begin() + static_cast<std::ptrdiff_t>(kept), deferred.end());
+}
+
+// remember the logger of msg, so its sinks get flushed at the end of shutdown().
+// shared_ptr mode: keep the logger alive until then. raw_ptr mode: its destructor waits for shutdown() to finish.
+void SPDLOG_INLINE thread_pool::record_shutdown_logger_(size_t worker_idx, const async_msg &msg)
+{
+    auto &loggers = shutdown_loggers_[worker_idx];
+    for (auto &logger : loggers)
+    {
+        if (logger.first == msg.worker)
+        {
+            return;
+        }
+    }
+    loggers.emplace_back(msg.worker, msg.worker_ptr);
+}
+
+// all messages before the drain message were processed by this thread.
+// wait until the other threads got there as well.
+void SPDLOG_INLINE thread_pool::arrive_at_barrier_()
+{
+    std::unique_lock<std::mutex> lock(barrier_mutex_);
+    auto generation = barrier_generation_;
+    barrier_arrived_++;
+    barrier_cv_.notify_all();
+    barrier_cv_.wait(lock, [this, generation] { return barrier_generation_ != generation; });
 }
 
 } // namespace details
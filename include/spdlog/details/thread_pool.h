@@ -3,36 +3,169 @@
 
 #pragma once
 
-#include <spdlog/details/log_msg_buffer.h>
-#include <spdlog/details/mpmc_blocking_q.h>
+#include <spdlog/details/deferred_format.h>
+#include <spdlog/details/log_msg.h>
+#ifdef SPDLOG_ASYNC_LOCKFREE_QUEUE
+#    include <spdlog/details/mpmc_lockfree_q.h>
+#else
+#    include <spdlog/details/mpmc_blocking_q.h>
+#endif
+#include <spdlog/details/mpmc_priority_q.h>
 #include <spdlog/details/os.h>
+#include <spdlog/details/spin_wait.h>
+#include <spdlog/details/thread_lanes.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 #include <functional>
 
 namespace spdlog {
 class async_logger;
 
+namespace details {
+static const size_t default_async_q_size = 8192;
+static const size_t default_async_lane_size = 1024;
+static const size_t default_async_batch_size = 64;
+} // namespace details
+
+// How log calls hand their messages over to the thread pool workers.
+enum class async_queue_mode
+{
+    shared_queue, // all producer threads push to one bounded queue (default)
+    thread_lanes, // each producer thread gets its own lock-free lane. workers merge the lanes by log time.
+                  // requires thread local storage (not available if SPDLOG_NO_TLS is defined).
+    sharded       // one queue (of queue_size) per worker. each logger is pinned to a shard,
+                  // so loggers are processed in parallel, each of them in order.
+};
+
+// How queued messages refer to their logger.
+enum class async_logger_ref
+{
+    shared_ptr, // each message holds a shared_ptr to its logger (default)
+    raw_ptr     // messages hold a raw pointer. saves two atomic ref count updates per message.
+                // loggers register with the pool and wait for the queue to drain when destroyed.
+};
+
+struct thread_pool_options
+{
+    size_t queue_size = details::default_async_q_size;
+    size_t threads_n = 1;
+    async_queue_mode queue_mode = async_queue_mode::shared_queue;
+    // max number of messages a worker pops from the queue at once.
+    // consecutive messages of the same logger are handed to its sinks as one batch.
+    size_t batch_size = details::default_async_batch_size;
+
+    // thread_lanes mode: capacity of each producer thread's lane.
+    size_t lane_size = details::default_async_lane_size;
+    // thread_lanes mode: how long a message waits for older messages from idle lanes
+    // before it is logged anyway. zero means log right away (best effort ordering).
+    std::chrono::microseconds lanes_max_skew{0};
+
+    async_logger_ref logger_ref = async_logger_ref::shared_ptr;
+
+    // how idle workers wait for messages. wait_spins and wait_yields are the thresholds of the
+    // spinning strategies (busy spins before yielding, yields before parking).
+#ifdef SPDLOG_ASYNC_LOCKFREE_QUEUE
+    async_wait_strategy wait_strategy = async_wait_strategy::spin_park;
+#else
+    async_wait_strategy wait_strategy = async_wait_strategy::blocking;
+#endif
+    unsigned wait_spins = details::spin_limit;
+    unsigned wait_yields = details::yield_limit;
+
+    // copy the arguments of log calls to the queue, and format them on the worker threads.
+    // only arithmetic and string arguments are supported, other log calls are formatted right away.
+    bool deferred_formatting = false;
+
+    // worker thread settings, applied by each worker before on_thread_start.
+    // the thread_pool constructor throws if any of them (except the name) can't be applied.
+    // cpus worker i is pinned to: worker_cpus[i % worker_cpus.size()]. empty means no pinning.
+    std::vector<std::vector<size_t>> worker_cpus;
+    // nice value of the workers, and whether they run with the SCHED_BATCH policy (linux only).
+    int worker_nice = 0;
+    bool worker_sched_batch = false;
+    // workers are named thread_name + their index. empty means unnamed.
+    std::string thread_name;
+    // allocate each queue from a thread pinned like the worker(s) reading it, so the kernel's
+    // first touch policy places the queue's memory on their NUMA node. requires worker_cpus.
+    // the lanes of async_queue_mode::thread_lanes are allocated by the producers and not affected.
+    bool numa_local_queues = false;
+
+    // priority lanes (shared_queue and sharded modes): each queue gets a high priority band for log messages
+    // of at least priority_level, which the workers drain first. after priority_max_streak high priority
+    // messages in a row, the next message comes from the low priority band, so it is not starved.
+    // each band holds queue_size messages and overruns on its own, so a burst of low priority messages
+    // never evicts high priority ones. flush requests are ordered after the messages of both bands before them.
+    // messages of a logger can be reordered across bands. uses a mutex based queue, even with SPDLOG_ASYNC_LOCKFREE_QUEUE.
+    bool priority_lanes = false;
+    level::level_enum priority_level = level::err;
+    size_t priority_max_streak = 256;
+
+    // queue depth monitoring (shared_queue and sharded modes), off by default: costs a few loads per message.
+    // fill levels, as fractions of a queue's capacity (e.g. {0.5, 0.9}). queue_level() tells how many
+    // of them a queue has reached, and its high water mark is tracked.
+    std::vector<double> queue_level_thresholds;
+    // called when the level of a queue changes, with the queue's shard and its new level (0: below all thresholds).
+    // runs on the posting thread when rising and on a worker thread when falling, so levels reported
+    // concurrently might arrive out of order. must not block or log to this pool.
+    std::function<void(size_t shard, size_t level)> on_queue_level;
+
+    std::function<void()> on_thread_start = [] {};
+    std::function<void()> on_thread_stop = [] {};
+};
+
 namespace details {
 
 using async_logger_ptr = std::shared_ptr<spdlog::async_logger>;
 
+// shared by a thread pool in async_logger_ref::raw_ptr mode and its loggers,
+// so a logger destroyed while the pool shuts down can wait for the workers to exit.
+struct thread_pool_exit
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done = false;
+};
+
 enum class async_msg_type
 {
     log,
     flush,
+    drain,
     terminate
 };
 
+#ifndef SPDLOG_ASYNC_INLINE_PAYLOAD_SIZE
+// chosen so that on 64 bit platforms an async_msg fills exactly 7 cache lines,
+// when it is cache line aligned (see the static_assert below async_msg)
+#    define SPDLOG_ASYNC_INLINE_PAYLOAD_SIZE 264
+#    define SPDLOG_ASYNC_DEFAULT_INLINE_PAYLOAD_SIZE_
+#endif
+
 // Async msg to move to/from the queue
 // Movable only. should never be copied
-struct async_msg : log_msg_buffer
+//
+// The payload is stored inline if it fits in SPDLOG_ASYNC_INLINE_PAYLOAD_SIZE bytes,
+// or in an overflow buffer otherwise. Overflow buffers are owned by the queue slots and
+// swapped (not freed) when messages are moved out of the queue, so after warm up even large
+// messages don't allocate.
+// The logger name is not copied: it refers to the name of the worker logger,
+// which is kept alive by worker_ptr, or by the pool draining the queue before it is destroyed.
+struct SPDLOG_CACHE_LINE_ALIGNED async_msg : log_msg
 {
     async_msg_type msg_type{async_msg_type::log};
-    async_logger_ptr worker_ptr;
+    async_logger *worker = nullptr;
+    async_logger_ptr worker_ptr; // empty in async_logger_ref::raw_ptr mode
+    deferred_format_fn format_fn = nullptr; // set if the payload holds serialized arguments
 
     async_msg() = default;
     ~async_msg() = default;
@@ -40,50 +173,156 @@ struct async_msg : log_msg_buffer
     // should only be moved in or out of the queue..
     async_msg(const async_msg &) = delete;
 
-// support for vs2013 move
-#if defined(_MSC_VER) && _MSC_VER <= 1800
     async_msg(async_msg &&other)
-        : log_msg_buffer(std::move(other))
-        , msg_type(other.msg_type)
-        , worker_ptr(std::move(other.worker_ptr))
-    {}
+        : log_msg{other}
+        , msg_type{other.msg_type}
+        , worker{other.worker}
+        , worker_ptr{std::move(other.worker_ptr)}
+        , format_fn{other.format_fn}
+    {
+        take_payload_(other);
+    }
 
     async_msg &operator=(async_msg &&other)
     {
-        *static_cast<log_msg_buffer *>(this) = std::move(other);
-        msg_type = other.msg_type;
-        worker_ptr = std::move(other.worker_ptr);
+        if (this != &other)
+        {
+            log_msg::operator=(other);
+            msg_type = other.msg_type;
+            worker = other.worker;
+            worker_ptr = std::move(other.worker_ptr);
+            format_fn = other.format_fn;
+            take_payload_(other);
+        }
         return *this;
     }
-#else // (_MSC_VER) && _MSC_VER <= 1800
-    async_msg(async_msg &&) = default;
-    async_msg &operator=(async_msg &&) = default;
-#endif
 
-    // construct from log_msg with given type
-    async_msg(async_logger_ptr &&worker, async_msg_type the_type, const details::log_msg &m)
-        : log_msg_buffer{m}
+    // construct from log_msg with given type.
+    // the payload still points to the caller's buffer: it gets copied into the queue slot
+    // when the message is moved into the queue.
+    async_msg(async_logger_ptr &&worker_logger, async_msg_type the_type, const details::log_msg &m)
+        : log_msg{m}
+        , msg_type{the_type}
+        , worker{worker_logger.get()}
+        , worker_ptr{std::move(worker_logger)}
+    {}
+
+    async_msg(async_logger *worker_logger, async_msg_type the_type, const details::log_msg &m)
+        : log_msg{m}
         , msg_type{the_type}
-        , worker_ptr{std::move(worker)}
+        , worker{worker_logger}
     {}
 
-    async_msg(async_logger_ptr &&worker, async_msg_type the_type)
-        : log_msg_buffer{}
+    async_msg(async_logger_ptr &&worker_logger, async_msg_type the_type)
+        : log_msg{}
         , msg_type{the_type}
-        , worker_ptr{std::move(worker)}
+        , worker{worker_logger.get()}
+        , worker_ptr{std::move(worker_logger)}
+    {}
+
+    async_msg(async_logger *worker_logger, async_msg_type the_type)
+        : log_msg{}
+        , msg_type{the_type}
+        , worker{worker_logger}
     {}
 
     explicit async_msg(async_msg_type the_type)
-        : async_msg{nullptr, the_type}
+        : async_msg{static_cast<async_logger *>(nullptr), the_type}
     {}
+
+    // replace the serialized arguments with the formatted message, using buf as scratch space.
+    // format_fn is left set if formatting throws.
+    void format_payload(memory_buf_t &buf)
+    {
+        buf.clear();
+        format_fn(payload, buf);
+        store_payload_(string_view_t(buf.data(), buf.size()));
+        format_fn = nullptr;
+    }
+
+private:
+    // overflow buffers bigger than this are released instead of being kept for reuse
+    static const size_t max_retained_overflow = 64 * 1024;
+
+    char inline_buf_[SPDLOG_ASYNC_INLINE_PAYLOAD_SIZE];
+    std::unique_ptr<char[]> overflow_;
+    size_t overflow_capacity_ = 0;
+
+    // take the payload of other (payload already refers to other's payload).
+    // steal its overflow buffer if it lives there (giving ours in exchange), or copy the bytes otherwise.
+    void take_payload_(async_msg &other)
+    {
+        if (overflow_ && payload.data() == overflow_.get())
+        {
+            return; // already ours
+        }
+        if (other.overflow_ && payload.data() == other.overflow_.get())
+        {
+            std::swap(overflow_, other.overflow_);
+            std::swap(overflow_capacity_, other.overflow_capacity_);
+            return;
+        }
+        store_payload_(payload);
+    }
+
+    void store_payload_(string_view_t src)
+    {
+        char *dest = inline_buf_;
+        if (src.size() > sizeof(inline_buf_))
+        {
+            if (overflow_capacity_ < src.size())
+            {
+                overflow_capacity_ = (std::max)(src.size(), overflow_capacity_ * 2);
+                overflow_.reset(new char[overflow_capacity_]);
+            }
+            dest = overflow_.get();
+        }
+        else if (overflow_capacity_ > max_retained_overflow)
+        {
+            overflow_.reset();
+            overflow_capacity_ = 0;
+        }
+
+        if (src.size() > 0)
+        {
+            std::memcpy(dest, src.data(), src.size());
+        }
+        payload = string_view_t{dest, src.size()};
+    }
+};
+
+#if defined(SPDLOG_ASYNC_DEFAULT_INLINE_PAYLOAD_SIZE_) && defined(__cpp_aligned_new)
+static_assert(sizeof(void *) != 8 || sizeof(async_msg) == 7 * cache_line_size,
+    "the default SPDLOG_ASYNC_INLINE_PAYLOAD_SIZE no longer fills 7 cache lines: adjust it to the size of async_msg");
+#endif
+
+// priority lanes: the band of a message. control messages are barriers in the low band.
+struct async_msg_band
+{
+    level::level_enum priority_level;
+
+    priority_band operator()(const async_msg &msg) const
+    {
+        if (msg.msg_type != async_msg_type::log)
+        {
+            return priority_band::low_barrier;
+        }
+        return msg.level >= priority_level ? priority_band::high : priority_band::low;
+    }
 };
 
 class SPDLOG_API thread_pool
 {
 public:
     using item_type = async_msg;
+#ifdef SPDLOG_ASYNC_LOCKFREE_QUEUE
+    using q_type = details::mpmc_lockfree_queue<item_type>;
+#else
     using q_type = details::mpmc_blocking_queue<item_type>;
+#endif
+    using priority_q_type = details::mpmc_priority_queue<item_type, async_msg_band>;
 
+    explicit thread_pool(const thread_pool_options &options);
     thread_pool(size_t q_max_items, size_t threads_n, std::function<void()> on_thread_start, std::function<void()> on_thread_stop);
     thread_pool(size_t q_max_items, size_t threads_n, std::function<void()> on_thread_start);
     thread_pool(size_t q_max_items, size_t threads_n);
@@ -94,24 +333,142 @@ public:
     thread_pool(const thread_pool &) = delete;
     thread_pool &operator=(thread_pool &&) = delete;
 
-    void post_log(async_logger_ptr &&worker_ptr, const details::log_msg &msg, async_overflow_policy overflow_policy);
-    void post_flush(async_logger_ptr &&worker_ptr, async_overflow_policy overflow_policy);
+    void post_log(async_logger_ptr &&worker_ptr, const details::log_msg &msg, async_overflow_policy overflow_policy,
+        deferred_format_fn format_fn = nullptr);
+    // return false if the flush message was dropped
+    bool post_flush(async_logger_ptr &&worker_ptr, async_overflow_policy overflow_policy);
+
+    // async_logger_ref::raw_ptr mode
+    void post_log(async_logger *worker, const details::log_msg &msg, async_overflow_policy overflow_policy,
+        deferred_format_fn format_fn = nullptr);
+    bool post_flush(async_logger *worker, async_overflow_policy overflow_policy);
+
+    bool deferred_formatting() const;
+
+    // state loggers must hold on to in async_logger_ref::raw_ptr mode, nullptr in shared_ptr mode
+    std::shared_ptr<thread_pool_exit> exit_state();
+
+    // wait until all messages posted before the call have been processed.
+    // the workers pause until the last of them got there. returns right away after shutdown().
+    void drain();
+
+    // process the queued messages for up to timeout, then stop the workers.
+    // messages still queued at the deadline, and messages posted once shutdown started, are dropped
+    // (and counted in their logger's drop_counter). at the end, the sinks of the loggers the workers
+    // got messages of during the shutdown are flushed, each sink once.
+    // return the number of dropped messages. later calls return 0.
+    // note: a sink call that is in progress at the deadline is still waited for.
+    size_t shutdown(std::chrono::milliseconds timeout);
     size_t overrun_counter();
     void reset_overrun_counter();
     size_t queue_size();
 
+    // queue depth monitoring, see thread_pool_options::queue_level_thresholds. lock-free, 0 if not enabled.
+    // number of thresholds the shard's queue currently reached, e.g. for producers to skip debug messages under pressure.
+    size_t queue_level(size_t shard = 0) const;
+    // max depth of the shard's queue since the last reset
+    size_t high_water_mark(size_t shard = 0) const;
+    void reset_high_water_mark();
+
+    // number of shards (queues): threads_n in sharded mode, 1 otherwise.
+    size_t shards_n() const;
+    size_t overrun_counter(size_t shard);
+    size_t queue_size(size_t shard);
+
 private:
-    q_type q_;
+    // either queues_ (one shared by all workers, or one per worker in sharded mode), priority_queues_ (the same,
+    // with priority lanes) or lanes_ is in use, depending on the queue mode.
+    std::vector<std::unique_ptr<q_type>> queues_;
+    std::vector<std::unique_ptr<priority_q_type>> priority_queues_;
+    std::unique_ptr<thread_lanes<item_type>> lanes_;
+
+    // queue depth monitoring: depths at which each threshold is reached (ascending), and per queue state
+    struct queue_level_state
+    {
+        char pad[cache_line_size];
+        std::atomic<size_t> level{0};
+        std::atomic<size_t> high_water{0};
+    };
+    std::vector<size_t> level_depths_;
+    std::vector<std::unique_ptr<queue_level_state>> queue_levels_;
+    std::function<void(size_t, size_t)> on_queue_level_;
 
     std::vector<std::thread> threads_;
+    size_t batch_size_;
+    bool deferred_formatting_;
+    std::shared_ptr<thread_pool_exit> exit_;
+
+    // drain() posts a drain message per worker and waits for all of them to arrive.
+    // also held by shutdown(), so they don't interleave.
+    std::mutex drain_mutex_;
+    std::mutex barrier_mutex_;
+    std::condition_variable barrier_cv_;
+    size_t barrier_arrived_ = 0;
+    size_t barrier_generation_ = 0;
+
+    // shutdown(): once shutting_down_ is set, workers record the loggers of the messages they get (per worker),
+    // and past shutdown_deadline_ drop the messages instead of processing them.
+    std::atomic<bool> shutting_down_{false};
+    std::atomic<bool> stopped_{false};
+    std::chrono::steady_clock::time_point shutdown_deadline_;
+    std::atomic<size_t> shutdown_dropped_{0};
+    std::vector<std::vector<std::pair<async_logger *, async_logger_ptr>>> shutdown_loggers_;
+
+    // apply the worker settings of options to the calling thread. return error message, or empty on success.
+    static std::string configure_worker_(const thread_pool_options &options, size_t worker_idx, bool affinity_only);
+    static wait_strategy wait_strategy_(const thread_pool_options &options);
+    void create_queues_(const thread_pool_options &options, size_t queues_n);
+    void stop_workers_();
+    size_t drop_leftovers_();
+    template<typename Q>
+    size_t drop_leftovers_(Q &q);
+    void flush_shutdown_loggers_();
+
+    void setup_queue_levels_(const thread_pool_options &options);
+    void update_queue_level_(size_t shard);
 
-    void post_async_msg_(async_msg &&new_msg, async_overflow_policy overflow_policy);
-    void worker_loop_();
+    // return false if the message was dropped
+    bool post_async_msg_(async_msg &&new_msg, async_overflow_policy overflow_policy);
+    template<typename Q>
+    bool enqueue_(Q &q, async_msg &&new_msg, async_overflow_policy overflow_policy);
+    // post drain or terminate message to the queue the given worker reads
+    void post_control_(size_t worker_idx, async_msg &&msg);
+    // number of queues_ or priority_queues_, and the one the given worker reads
+    size_t queues_n_() const;
+    size_t worker_queue_idx_(size_t worker_idx) const;
+    void worker_loop_(size_t worker_idx);
+    void arrive_at_barrier_();
+    void record_shutdown_logger_(size_t worker_idx, const async_msg &msg);
+
+    // flush of a logger whose flush requests were merged into the flush message the worker just handled.
+    // it is due once the worker dequeued the messages that were queued at that time (which include the
+    // messages logged before the merged requests), or found the queue empty.
+    struct deferred_flush
+    {
+        async_logger *worker;
+        async_logger_ptr worker_ptr;
+        size_t due; // value of worker_state::dequeued
+    };
+
+    // buffers and pending flushes of a worker thread
+    struct worker_state
+    {
+        std::vector<async_msg> batch;
+        std::vector<log_msg> run;
+        std::vector<format_cache> run_caches; // one per message of run, for loggers with several sinks
+        memory_buf_t formatted;
+        size_t dequeued = 0;                        // messages dequeued so far
+        std::vector<deferred_flush> merged_flushes; // found in the current batch
+        std::vector<deferred_flush> deferred_flushes;
+    };
 
-    // process next message in the queue
+    // process next batch of messages in the queue
     // return true if this thread should still be active (while no terminate msg
     // was received)
-    bool process_next_msg_();
+    bool process_next_msg_(size_t worker_idx, worker_state &state);
+    // run the deferred flushes that are due, or all of them if settle is set (drain and terminate).
+    // discard: release their waiters without flushing.
+    void run_deferred_flushes_(size_t worker_idx, worker_state &state, bool settle, bool discard);
 };
 
 } // namespace details
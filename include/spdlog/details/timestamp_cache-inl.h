@@ -0,0 +1,108 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#ifndef SPDLOG_HEADER_ONLY
+#    include <spdlog/details/timestamp_cache.h>
+#endif
+
+#include <spdlog/details/fmt_helper.h>
+#include <spdlog/details/os.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace spdlog {
+namespace details {
+
+SPDLOG_INLINE timestamp_cache &timestamp_cache::instance()
+{
+    static timestamp_cache cache;
+    return cache;
+}
+
+SPDLOG_INLINE void timestamp_cache::get(std::chrono::seconds secs, pattern_time_type time_type, cached_time &dest)
+{
+    auto &e = entries_[time_type == pattern_time_type::local ? 0 : 1];
+    uint32_t seq;
+    bool cached = read_(e, dest, seq);
+    if (cached && dest.secs == secs)
+    {
+        return;
+    }
+    bool newer = !cached || dest.secs < secs;
+    compute(secs, time_type, dest);
+    // a writer in progress (odd seq) or a failed read: leave it to the others
+    if (newer && (seq & 1) == 0)
+    {
+        publish_(e, seq, dest);
+    }
+}
+
+SPDLOG_INLINE void timestamp_cache::compute(std::chrono::seconds secs, pattern_time_type time_type, cached_time &dest)
+{
+    auto tt = static_cast<std::time_t>(secs.count());
+    dest.secs = secs;
+    dest.tm = time_type == pattern_time_type::local ? os::localtime(tt) : os::gmtime(tt);
+    dest.utc_offset_minutes = os::utc_minutes_offset(dest.tm);
+
+    memory_buf_t buf;
+    fmt_helper::append_int(dest.tm.tm_year + 1900, buf);
+    buf.push_back('-');
+    fmt_helper::pad2(dest.tm.tm_mon + 1, buf);
+    buf.push_back('-');
+    fmt_helper::pad2(dest.tm.tm_mday, buf);
+    buf.push_back(' ');
+    fmt_helper::pad2(dest.tm.tm_hour, buf);
+    buf.push_back(':');
+    fmt_helper::pad2(dest.tm.tm_min, buf);
+    buf.push_back(':');
+    fmt_helper::pad2(dest.tm.tm_sec, buf);
+    dest.datetime_size = (std::min)(buf.size(), sizeof(dest.datetime));
+    std::memcpy(dest.datetime, buf.data(), dest.datetime_size);
+}
+
+// copy the entry to dest. return false if it was never written, or is being written (seq is odd then).
+SPDLOG_INLINE bool timestamp_cache::read_(entry &e, cached_time &dest, uint32_t &seq)
+{
+    seq = e.seq.load(std::memory_order_acquire);
+    if (seq == 0 || (seq & 1) != 0)
+    {
+        return false;
+    }
+    uint64_t words[words_n];
+    for (size_t i = 0; i < words_n; i++)
+    {
+        words[i] = e.words[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (e.seq.load(std::memory_order_relaxed) != seq)
+    {
+        seq = 1;
+        return false;
+    }
+    std::memcpy(&dest, words, sizeof(cached_time));
+    return true;
+}
+
+// write the entry, unless another thread updated it since seq was read
+SPDLOG_INLINE void timestamp_cache::publish_(entry &e, uint32_t seq, const cached_time &time)
+{
+    if (!e.seq.compare_exchange_strong(seq, seq + 1, std::memory_order_relaxed))
+    {
+        return;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    uint64_t words[words_n] = {};
+    std::memcpy(words, &time, sizeof(cached_time));
+    for (size_t i = 0; i < words_n; i++)
+    {
+        e.words[i].store(words[i], std::memory_order_relaxed);
+    }
+    // skip 0 (never written) on wrap around
+    e.seq.store(seq + 2 == 0 ? 2 : seq + 2, std::memory_order_release);
+}
+
+} // namespace details
+} // namespace spdlog
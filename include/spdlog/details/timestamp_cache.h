@@ -0,0 +1,67 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#include <spdlog/common.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+
+namespace spdlog {
+namespace details {
+
+// The calendar time of a second since epoch, with its utc offset and its "YYYY-MM-DD HH:MM:SS" rendering.
+// Trivially copyable: timestamp_cache stores it as words.
+struct cached_time
+{
+    std::chrono::seconds secs{(std::chrono::seconds::min)()}; // min: none
+    std::tm tm{};
+    int utc_offset_minutes = 0;
+    size_t datetime_size = 0;
+    char datetime[24];
+
+    string_view_t datetime_view() const
+    {
+        return string_view_t(datetime, datetime_size);
+    }
+};
+
+// Process wide cache of the cached_time of the latest second logged, in local time and in utc,
+// shared by the formatters of all loggers and sinks: the time is converted and rendered once per second.
+// Readers take no lock (seqlock) and never wait: if the entry is being updated, or holds another second,
+// they compute the cached_time themselves (and publish it if it's newer).
+class SPDLOG_API timestamp_cache
+{
+public:
+    static timestamp_cache &instance();
+
+    // set dest to the cached_time of the given second, in local time or utc
+    void get(std::chrono::seconds secs, pattern_time_type time_type, cached_time &dest);
+
+    static void compute(std::chrono::seconds secs, pattern_time_type time_type, cached_time &dest);
+
+private:
+    static const size_t words_n = (sizeof(cached_time) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    // the entry is stored in atomic words, so torn reads are well defined (and discarded)
+    struct entry
+    {
+        std::atomic<uint32_t> seq{0}; // odd while being written, 0 if never written
+        std::atomic<uint64_t> words[words_n];
+    };
+
+    entry entries_[2]; // local, utc
+
+    static bool read_(entry &e, cached_time &dest, uint32_t &seq);
+    static void publish_(entry &e, uint32_t seq, const cached_time &time);
+};
+
+} // namespace details
+} // namespace spdlog
+
+#ifdef SPDLOG_HEADER_ONLY
+#    include "timestamp_cache-inl.h"
+#endif
@@ -14,5 +14,49 @@ public:
     virtual ~formatter() = default;
     virtual void format(const details::log_msg &msg, memory_buf_t &dest) = 0;
     virtual std::unique_ptr<formatter> clone() const = 0;
+
+    // formatters with the same non empty key format any message the same way.
+    // empty (the default) if the output depends on the formatter's state or on user code.
+    virtual string_view_t format_key() const
+    {
+        return string_view_t{};
+    }
+
+    // format(), unless another sink of the logger formatted the message with the same key already:
+    // its text is copied then. the first sink with a key leaves its text for the others.
+    void format_shared(const details::log_msg &msg, memory_buf_t &dest)
+    {
+        details::format_cache *cache = msg.fmt_cache;
+        string_view_t key = cache != nullptr ? format_key() : string_view_t{};
+        if (key.size() == 0)
+        {
+            format(msg, dest);
+            return;
+        }
+
+        const size_t start = dest.size();
+        if (cache->filled && string_view_t(cache->key.data(), cache->key.size()) == key)
+        {
+            dest.append(cache->text.data(), cache->text.data() + cache->text.size());
+            if (cache->color_range_end > cache->color_range_start)
+            {
+                msg.color_range_start = start + cache->color_range_start;
+                msg.color_range_end = start + cache->color_range_end;
+            }
+            return;
+        }
+
+        format(msg, dest);
+        if (cache->filled)
+        {
+            return;
+        }
+        cache->key.append(key.data(), key.data() + key.size());
+        cache->text.append(dest.data() + start, dest.data() + dest.size());
+        bool colored = msg.color_range_end > msg.color_range_start && msg.color_range_start >= start;
+        cache->color_range_start = colored ? msg.color_range_start - start : 0;
+        cache->color_range_end = colored ? msg.color_range_end - start : 0;
+        cache->filled = true;
+    }
 };
 } // namespace spdlog
@@ -0,0 +1,236 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#ifndef SPDLOG_HEADER_ONLY
+#    include <spdlog/json_formatter.h>
+#endif
+
+#include <spdlog/details/fmt_helper.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace spdlog {
+
+namespace details {
+namespace json {
+inline bool needs_escape(unsigned char c)
+{
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+// whether any of the 8 bytes of v needs escaping.
+// a byte below 0x20, or equal to '"' or '\\' (zero once xored with it), leaves its high bit set in the result.
+inline bool needs_escape8(uint64_t v)
+{
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t quote = v ^ (ones * '"');
+    const uint64_t backslash = v ^ (ones * '\\');
+    const uint64_t found = ((v - ones * 0x20) & ~v) | ((quote - ones) & ~quote) | ((backslash - ones) & ~backslash);
+    return (found & (ones * 0x80)) != 0;
+}
+
+inline void append_escape(unsigned char c, memory_buf_t &dest)
+{
+    static const char hex[] = "0123456789abcdef";
+    char buf[6] = {'\\', 0, 0, 0, 0, 0};
+    size_t size = 2;
+    switch (c)
+    {
+    case '"':
+    case '\\':
+        buf[1] = static_cast<char>(c);
+        break;
+    case '\n':
+        buf[1] = 'n';
+        break;
+    case '\r':
+        buf[1] = 'r';
+        break;
+    case '\t':
+        buf[1] = 't';
+        break;
+    case '\b':
+        buf[1] = 'b';
+        break;
+    case '\f':
+        buf[1] = 'f';
+        break;
+    default:
+        std::memcpy(buf + 1, "u00", 3);
+        buf[4] = hex[c >> 4];
+        buf[5] = hex[c & 0xf];
+        size = 6;
+        break;
+    }
+    dest.append(buf, buf + size);
+}
+
+// append str escaped as the contents of a JSON string.
+// clean spans are found 8 bytes at a time, and copied at once.
+inline void append_escaped(string_view_t str, memory_buf_t &dest)
+{
+    const char *p = str.data();
+    const char *end = p + str.size();
+    const char *clean = p; // start of the span not copied yet
+    for (;;)
+    {
+        while (end - p >= 8)
+        {
+            uint64_t block;
+            std::memcpy(&block, p, sizeof(block));
+            if (needs_escape8(block))
+            {
+                break;
+            }
+            p += 8;
+        }
+        while (p < end && !needs_escape(static_cast<unsigned char>(*p)))
+        {
+            p++;
+        }
+        if (p == end)
+        {
+            break;
+        }
+        dest.append(clean, p);
+        append_escape(static_cast<unsigned char>(*p), dest);
+        clean = ++p;
+    }
+    dest.append(clean, end);
+}
+
+// append "key":"value" with both escaped
+inline void append_member(string_view_t key, string_view_t value, memory_buf_t &dest)
+{
+    dest.push_back('"');
+    append_escaped(key, dest);
+    fmt_helper::append_string_view("\":\"", dest);
+    append_escaped(value, dest);
+    dest.push_back('"');
+}
+} // namespace json
+} // namespace details
+
+SPDLOG_INLINE json_formatter::json_formatter(pattern_time_type time_type, std::string eol)
+    : time_type_(time_type)
+    , eol_(std::move(eol))
+{
+    update_format_key_();
+}
+
+SPDLOG_INLINE json_formatter &json_formatter::add_field(string_view_t key, string_view_t value)
+{
+    memory_buf_t buf;
+    buf.push_back(',');
+    details::json::append_member(key, value, buf);
+    fields_.append(buf.data(), buf.size());
+    update_format_key_();
+    return *this;
+}
+
+SPDLOG_INLINE std::unique_ptr<formatter> json_formatter::clone() const
+{
+    auto cloned = details::make_unique<json_formatter>(time_type_, eol_);
+    cloned->fields_ = fields_;
+    cloned->update_format_key_();
+#if defined(__GNUC__) && __GNUC__ < 5
+    return std::move(cloned);
+#else
+    return cloned;
+#endif
+}
+
+SPDLOG_INLINE void json_formatter::format(const details::log_msg &msg, memory_buf_t &dest)
+{
+    using details::fmt_helper::append_string_view;
+
+    const auto secs = std::chrono::duration_cast<std::chrono::seconds>(msg.time.time_since_epoch());
+    if (secs != cached_time_.secs)
+    {
+        details::timestamp_cache::instance().get(secs, time_type_, cached_time_);
+        render_time_();
+    }
+    append_string_view(time_prefix_, dest);
+    auto micros = details::fmt_helper::time_fraction<std::chrono::microseconds>(msg.time);
+    details::fmt_helper::append_fixed<6>(static_cast<uint32_t>(micros.count()), dest);
+    append_string_view(time_suffix_, dest);
+
+    details::json::append_escaped(level::to_string_view(msg.level), dest);
+    append_string_view("\",\"logger\":\"", dest);
+    details::json::append_escaped(msg.logger_name, dest);
+    append_string_view("\",\"thread\":", dest);
+    details::fmt_helper::append_uint(msg.thread_id, dest);
+
+    if (!msg.source.empty())
+    {
+        append_string_view(",\"source\":{\"file\":\"", dest);
+        details::json::append_escaped(msg.source.filename != nullptr ? msg.source.filename : "", dest);
+        append_string_view("\",\"line\":", dest);
+        details::fmt_helper::append_int(msg.source.line, dest);
+        append_string_view(",\"function\":\"", dest);
+        details::json::append_escaped(msg.source.funcname != nullptr ? msg.source.funcname : "", dest);
+        append_string_view("\"}", dest);
+    }
+
+    append_string_view(",\"message\":\"", dest);
+    details::json::append_escaped(msg.payload, dest);
+    dest.push_back('"');
+    append_string_view(fields_, dest);
+    dest.push_back('}');
+    append_string_view(eol_, dest);
+}
+
+SPDLOG_INLINE string_view_t json_formatter::format_key() const
+{
+    return format_key_;
+}
+
+// ISO 8601, e.g. 2024-05-01T12:34:56.123456+02:00 (Z in utc)
+SPDLOG_INLINE void json_formatter::render_time_()
+{
+    auto datetime = cached_time_.datetime_view();
+    time_prefix_.assign("{\"time\":\"");
+    time_prefix_.append(datetime.data(), datetime.size());
+    auto space = time_prefix_.rfind(' ');
+    if (space != std::string::npos)
+    {
+        time_prefix_[space] = 'T';
+    }
+    time_prefix_ += '.';
+
+    time_suffix_.clear();
+    if (time_type_ == pattern_time_type::utc)
+    {
+        time_suffix_ += 'Z';
+    }
+    else
+    {
+        const int offset = cached_time_.utc_offset_minutes;
+        const int minutes = std::abs(offset);
+        const char *hours = details::fmt_helper::digits2(static_cast<unsigned int>(minutes / 60 % 100));
+        const char *mins = details::fmt_helper::digits2(static_cast<unsigned int>(minutes % 60));
+        time_suffix_ += offset < 0 ? '-' : '+';
+        time_suffix_.append(hours, 2);
+        time_suffix_ += ':';
+        time_suffix_.append(mins, 2);
+    }
+    time_suffix_.append("\",\"level\":\"");
+}
+
+// distinct from the keys of pattern_formatter, which start with a digit
+SPDLOG_INLINE void json_formatter::update_format_key_()
+{
+    format_key_ = "json:";
+    format_key_ += time_type_ == pattern_time_type::local ? 'l' : 'u';
+    format_key_ += std::to_string(eol_.size());
+    format_key_ += ':';
+    format_key_ += eol_;
+    format_key_ += fields_;
+}
+
+} // namespace spdlog
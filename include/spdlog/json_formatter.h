@@ -0,0 +1,68 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// Formats messages as JSON objects, one per line (JSON lines):
+//
+//     {"time":"2024-05-01T12:34:56.123456+02:00","level":"info","logger":"app","thread":1234,
+//      "source":{"file":"main.cpp","line":12,"function":"main"},"message":"said \"hi\"","service":"api"}
+//
+// "source" is present only if the message has a source location. The fields added with add_field() come last.
+// Strings are escaped as JSON requires: quotes, backslashes and control characters.
+// Other bytes (e.g. UTF-8 sequences) are copied as they are.
+// The date and time are rendered once per second, like pattern_formatter does (see details::timestamp_cache).
+//
+//     auto sink = std::make_shared<spdlog::sinks::basic_file_sink_mt>("logs/app.jsonl");
+//     auto formatter = spdlog::details::make_unique<spdlog::json_formatter>();
+//     formatter->add_field("service", "api");
+//     sink->set_formatter(std::move(formatter));
+
+#include <spdlog/common.h>
+#include <spdlog/details/log_msg.h>
+#include <spdlog/details/os.h>
+#include <spdlog/details/timestamp_cache.h>
+#include <spdlog/formatter.h>
+
+#include <memory>
+#include <string>
+
+namespace spdlog {
+
+class SPDLOG_API json_formatter final : public formatter
+{
+public:
+    explicit json_formatter(pattern_time_type time_type = pattern_time_type::local, std::string eol = spdlog::details::os::default_eol);
+
+    json_formatter(const json_formatter &other) = delete;
+    json_formatter &operator=(const json_formatter &other) = delete;
+
+    // add a "key":"value" member to every message
+    json_formatter &add_field(string_view_t key, string_view_t value);
+
+    std::unique_ptr<formatter> clone() const override;
+    void format(const details::log_msg &msg, memory_buf_t &dest) override;
+    // the time type, eol and fields
+    string_view_t format_key() const override;
+
+private:
+    pattern_time_type time_type_;
+    std::string eol_;
+    std::string fields_; // rendered: ,"key":"value"...
+    std::string format_key_;
+
+    // the message's second, from the timestamp_cache, and its rendering around the fraction of the second:
+    // {"time":"YYYY-MM-DDTHH:MM:SS.  and  +hh:mm","level":"
+    details::cached_time cached_time_;
+    std::string time_prefix_;
+    std::string time_suffix_;
+
+    void render_time_();
+    void update_format_key_();
+};
+
+} // namespace spdlog
+
+#ifdef SPDLOG_HEADER_ONLY
+#    include "json_formatter-inl.h"
+#endif
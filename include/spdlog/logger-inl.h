@@ -23,16 +23,23 @@ SPDLOG_INLINE logger::logger(const logger &other)
     , flush_level_(other.flush_level_.load(std::memory_order_relaxed))
     , custom_err_handler_(other.custom_err_handler_)
     , tracer_(other.tracer_)
-{}
+    , defer_formatting_(other.defer_formatting_)
+{
+    count_serialized_sinks_();
+}
 
 SPDLOG_INLINE logger::logger(logger &&other) SPDLOG_NOEXCEPT : name_(std::move(other.name_)),
                                                                sinks_(std::move(other.sinks_)),
                                                                level_(other.level_.load(std::memory_order_relaxed)),
                                                                flush_level_(other.flush_level_.load(std::memory_order_relaxed)),
                                                                custom_err_handler_(std::move(other.custom_err_handler_)),
-                                                               tracer_(std::move(other.tracer_))
+                                                               tracer_(std::move(other.tracer_)),
+                                                               defer_formatting_(other.defer_formatting_)
 
-{}
+{
+    count_serialized_sinks_();
+    other.count_serialized_sinks_();
+}
 
 SPDLOG_INLINE logger &logger::operator=(logger other) SPDLOG_NOEXCEPT
 {
@@ -44,6 +51,8 @@ SPDLOG_INLINE void logger::swap(spdlog::logger &other) SPDLOG_NOEXCEPT
 {
     name_.swap(other.name_);
     sinks_.swap(other.sinks_);
+    count_serialized_sinks_();
+    other.count_serialized_sinks_();
 
     // swap level_
     auto other_level = other.level_.load();
@@ -57,6 +66,9 @@ SPDLOG_INLINE void logger::swap(spdlog::logger &other) SPDLOG_NOEXCEPT
 
     custom_err_handler_.swap(other.custom_err_handler_);
     std::swap(tracer_, other.tracer_);
+    std::swap(defer_formatting_, other.defer_formatting_);
+    callsite_token_.store(details::callsite::new_token(), std::memory_order_release);
+    other.callsite_token_.store(details::callsite::new_token(), std::memory_order_release);
 }
 
 SPDLOG_INLINE void swap(logger &a, logger &b)
@@ -67,6 +79,8 @@ SPDLOG_INLINE void swap(logger &a, logger &b)
 SPDLOG_INLINE void logger::set_level(level::level_enum log_level)
 {
     level_.store(log_level);
+    // call sites cached as disabled for the old token don't match anymore
+    callsite_token_.store(details::callsite::new_token(), std::memory_order_release);
 }
 
 SPDLOG_INLINE level::level_enum logger::level() const
@@ -108,12 +122,14 @@ SPDLOG_INLINE void logger::set_pattern(std::string pattern, pattern_time_type ti
 SPDLOG_INLINE void logger::enable_backtrace(size_t n_messages)
 {
     tracer_.enable(n_messages);
+    callsite_token_.store(details::callsite::new_token(), std::memory_order_release);
 }
 
 // restore orig sinks and level and delete the backtrace sink
 SPDLOG_INLINE void logger::disable_backtrace()
 {
     tracer_.disable();
+    callsite_token_.store(details::callsite::new_token(), std::memory_order_release);
 }
 
 SPDLOG_INLINE void logger::dump_backtrace()
@@ -143,8 +159,10 @@ SPDLOG_INLINE const std::vector<sink_ptr> &logger::sinks() const
     return sinks_;
 }
 
+// the caller might change the sinks: count them again on the next use
 SPDLOG_INLINE std::vector<sink_ptr> &logger::sinks()
 {
+    serialized_sinks_n_.store(sinks_changed_, std::memory_order_relaxed);
     return sinks_;
 }
 
@@ -175,8 +193,15 @@ SPDLOG_INLINE void logger::log_it_(const spdlog::details::log_msg &log_msg, bool
     }
 }
 
+// sinks with the same format share the formatted text through a format cache (see formatter::format_shared())
 SPDLOG_INLINE void logger::sink_it_(const details::log_msg &msg)
 {
+    details::scratch_format_cache cache(sinks_.size() > 1 && msg.fmt_cache == nullptr);
+    bool shared = cache.get() != nullptr;
+    if (shared)
+    {
+        msg.fmt_cache = cache.get();
+    }
     for (auto &sink : sinks_)
     {
         if (sink->should_log(msg.level))
@@ -188,6 +213,10 @@ SPDLOG_INLINE void logger::sink_it_(const details::log_msg &msg)
             SPDLOG_LOGGER_CATCH(msg.source)
         }
     }
+    if (shared)
+    {
+        msg.fmt_cache = nullptr;
+    }
 
     if (should_flush_(msg))
     {
@@ -195,6 +224,38 @@ SPDLOG_INLINE void logger::sink_it_(const details::log_msg &msg)
     }
 }
 
+// the sinks storing the serialized arguments get them along with the formatted message,
+// which is left empty if no other sink needs it.
+SPDLOG_INLINE void logger::sink_deferred_(const details::log_msg &msg, details::deferred_format_fn format_fn)
+{
+    details::log_msg formatted(msg);
+    formatted.serialized = msg.payload;
+    formatted.payload = string_view_t{};
+    memory_buf_t buf;
+    if (serialized_sinks_() < sinks_.size())
+    {
+        format_fn(msg.payload, buf);
+        formatted.payload = string_view_t(buf.data(), buf.size());
+    }
+    sink_it_(formatted);
+}
+
+SPDLOG_INLINE size_t logger::count_serialized_sinks_() const
+{
+    size_t n = 0;
+    for (auto &sink : sinks_)
+    {
+        if (sink->wants_serialized())
+        {
+            n++;
+        }
+    }
+    counted_sinks_size_.store(sinks_.size(), std::memory_order_relaxed);
+    counted_sinks_data_.store(sinks_.data(), std::memory_order_relaxed);
+    serialized_sinks_n_.store(n, std::memory_order_relaxed);
+    return n;
+}
+
 SPDLOG_INLINE void logger::flush_()
 {
     for (auto &sink : sinks_)
@@ -213,7 +274,17 @@ SPDLOG_INLINE void logger::dump_backtrace_()
     if (tracer_.enabled() && !tracer_.empty())
     {
         sink_it_(log_msg{name(), level::info, "****************** Backtrace Start ******************"});
-        tracer_.foreach_pop([this](const log_msg &msg) { this->sink_it_(msg); });
+        // a message failing to format is reported and skipped
+        bool done = false;
+        while (!done)
+        {
+            SPDLOG_TRY
+            {
+                tracer_.foreach_pop([this](const log_msg &msg) { this->sink_it_(msg); });
+                done = true;
+            }
+            SPDLOG_LOGGER_CATCH(source_loc())
+        }
         sink_it_(log_msg{name(), level::info, "****************** Backtrace End ********************"});
     }
 }
@@ -17,6 +17,16 @@
 #include <spdlog/common.h>
 #include <spdlog/details/log_msg.h>
 #include <spdlog/details/backtracer.h>
+#include <spdlog/details/callsite.h>
+#include <spdlog/details/deferred_format.h>
+#include <spdlog/details/scratch_buffer.h>
+
+#ifdef SPDLOG_COMPILED_FORMAT
+#    ifdef SPDLOG_USE_STD_FORMAT
+#        error SPDLOG_COMPILED_FORMAT is not supported with SPDLOG_USE_STD_FORMAT
+#    endif
+#    include <spdlog/fmt/compile.h>
+#endif
 
 #ifdef SPDLOG_WCHAR_TO_UTF8_SUPPORT
 #    ifndef _WIN32
@@ -25,6 +35,7 @@
 #    include <spdlog/details/os.h>
 #endif
 
+#include <type_traits>
 #include <vector>
 
 #ifndef SPDLOG_NO_EXCEPTIONS
@@ -51,6 +62,21 @@
 
 namespace spdlog {
 
+namespace details {
+// format string made by FMT_COMPILE (only with C++17, before that FMT_COMPILE makes an ordinary format string)
+#ifdef SPDLOG_COMPILED_FORMAT
+template<typename T>
+struct is_compiled_format_string : fmt::detail::is_compiled_string<T>
+{};
+#else
+template<typename T>
+struct is_compiled_format_string : std::false_type
+{};
+#endif
+
+struct callsite_access;
+} // namespace details
+
 class SPDLOG_API logger
 {
 public:
@@ -58,14 +84,18 @@ public:
     explicit logger(std::string name)
         : name_(std::move(name))
         , sinks_()
-    {}
+    {
+        count_serialized_sinks_();
+    }
 
     // Logger with range on sinks
     template<typename It>
     logger(std::string name, It begin, It end)
         : name_(std::move(name))
         , sinks_(begin, end)
-    {}
+    {
+        count_serialized_sinks_();
+    }
 
     // Logger with single sink
     logger(std::string name, sink_ptr single_sink)
@@ -103,12 +133,29 @@ public:
     }
 
     // T cannot be statically converted to format string (including string_view/wstring_view)
-    template<class T, typename std::enable_if<!is_convertible_to_any_format_string<const T &>::value, int>::type = 0>
+    template<class T, typename std::enable_if<!is_convertible_to_any_format_string<const T &>::value &&
+                                                  !details::is_compiled_format_string<T>::value,
+                          int>::type = 0>
     void log(source_loc loc, level::level_enum lvl, const T &msg)
     {
         log(loc, lvl, "{}", msg);
     }
 
+#ifdef SPDLOG_COMPILED_FORMAT
+    // format string compiled by FMT_COMPILE: parsed, and its arguments dispatched, at compile time
+    template<typename S, typename... Args, typename std::enable_if<details::is_compiled_format_string<S>::value, int>::type = 0>
+    void log(source_loc loc, level::level_enum lvl, const S &fmt, Args &&...args)
+    {
+        log_(loc, lvl, fmt, std::forward<Args>(args)...);
+    }
+
+    template<typename S, typename... Args, typename std::enable_if<details::is_compiled_format_string<S>::value, int>::type = 0>
+    void log(level::level_enum lvl, const S &fmt, Args &&...args)
+    {
+        log(source_loc{}, lvl, fmt, std::forward<Args>(args)...);
+    }
+#endif
+
     void log(log_clock::time_point log_time, source_loc loc, level::level_enum lvl, string_view_t msg)
     {
         bool log_enabled = should_log(lvl);
@@ -339,6 +386,8 @@ public:
     // sinks
     const std::vector<sink_ptr> &sinks() const;
 
+    // sinks added or removed through the returned reference are picked up on the next log call,
+    // even if the reference is kept. to replace a sink in place, call sinks() again for it.
     std::vector<sink_ptr> &sinks();
 
     // error handler
@@ -354,10 +403,25 @@ protected:
     spdlog::level_t flush_level_{level::off};
     err_handler custom_err_handler_{nullptr};
     details::backtracer tracer_;
-
-    // common implementation for after templated public api has been resolved
-    template<typename... Args>
-    void log_(source_loc loc, level::level_enum lvl, string_view_t fmt, Args &&...args)
+    // hand supported arguments to sink_deferred_() unformatted (async loggers)
+    bool defer_formatting_{false};
+    // number of sinks that want the arguments serialized, see serialized_sinks_().
+    // counted in the constructors, and again on the first use after sinks() gave access to the sinks
+    // or after the sink vector was resized or reallocated (through a reference kept from sinks()).
+    static constexpr size_t sinks_changed_ = SIZE_MAX;
+    mutable std::atomic<size_t> serialized_sinks_n_{sinks_changed_};
+    mutable std::atomic<size_t> counted_sinks_size_{0};
+    mutable std::atomic<const sink_ptr *> counted_sinks_data_{nullptr};
+    // the call sites cached as disabled for this logger match it by this token (see details::callsite).
+    // a copy gets a token of its own, and a new one is taken whenever the level or backtrace changes.
+    std::atomic<size_t> callsite_token_{details::callsite::new_token()};
+
+    friend struct details::callsite_access;
+
+    // common implementation for after templated public api has been resolved.
+    // fmt is a string_view_t, or a compiled format string.
+    template<typename S, typename... Args>
+    void log_(source_loc loc, level::level_enum lvl, const S &fmt, Args &&...args)
     {
         bool log_enabled = should_log(lvl);
         bool traceback_enabled = tracer_.enabled();
@@ -365,14 +429,37 @@ protected:
         {
             return;
         }
+        log_checked_(loc, lvl, log_enabled, traceback_enabled, fmt, args...);
+    }
+
+    // log_(), once the levels were checked
+    template<typename S, typename... Args>
+    void log_checked_(source_loc loc, level::level_enum lvl, bool log_enabled, bool traceback_enabled, const S &fmt, Args &...args)
+    {
         SPDLOG_TRY
         {
-            memory_buf_t buf;
-#ifdef SPDLOG_USE_STD_FORMAT
-            fmt_lib::vformat_to(std::back_inserter(buf), fmt, fmt_lib::make_format_args(args...));
-#else
-            fmt::vformat_to(fmt::appender(buf), fmt, fmt::make_format_args(args...));
-#endif
+            details::scratch_buffer scratch;
+            auto &buf = scratch.get();
+            // sinks get the arguments serialized if the logger defers formatting, or some sink wants them.
+            // the backtracer stores them so too, to be formatted only if dumped.
+            bool deferred = log_enabled && (defer_formatting_ || serialized_sinks_() > 0);
+            if (deferred || (traceback_enabled && !log_enabled))
+            {
+                if (auto format_fn = details::serialize_args(buf, string_view_t(fmt), args...))
+                {
+                    details::log_msg log_msg(loc, name_, lvl, string_view_t(buf.data(), buf.size()));
+                    if (traceback_enabled)
+                    {
+                        tracer_.push_back(log_msg, format_fn);
+                    }
+                    if (log_enabled)
+                    {
+                        sink_deferred_(log_msg, format_fn);
+                    }
+                    return;
+                }
+            }
+            format_to_(buf, fmt, args...);
 
             details::log_msg log_msg(loc, name_, lvl, string_view_t(buf.data(), buf.size()));
             log_it_(log_msg, log_enabled, traceback_enabled);
@@ -380,6 +467,24 @@ protected:
         SPDLOG_LOGGER_CATCH(loc)
     }
 
+    template<typename... Args>
+    static void format_to_(memory_buf_t &buf, string_view_t fmt, Args &...args)
+    {
+#ifdef SPDLOG_USE_STD_FORMAT
+        fmt_lib::vformat_to(std::back_inserter(buf), fmt, fmt_lib::make_format_args(args...));
+#else
+        fmt::vformat_to(fmt::appender(buf), fmt, fmt::make_format_args(args...));
+#endif
+    }
+
+#ifdef SPDLOG_COMPILED_FORMAT
+    template<typename S, typename... Args, typename std::enable_if<details::is_compiled_format_string<S>::value, int>::type = 0>
+    static void format_to_(memory_buf_t &buf, const S &fmt, Args &...args)
+    {
+        fmt::format_to(fmt::appender(buf), fmt, args...);
+    }
+#endif
+
 #ifdef SPDLOG_WCHAR_TO_UTF8_SUPPORT
     template<typename... Args>
     void log_(source_loc loc, level::level_enum lvl, wstring_view_t fmt, Args &&...args)
@@ -396,7 +501,8 @@ protected:
             wmemory_buf_t wbuf;
             fmt_lib::vformat_to(std::back_inserter(wbuf), fmt, fmt_lib::make_format_args<fmt_lib::wformat_context>(args...));
 
-            memory_buf_t buf;
+            details::scratch_buffer scratch;
+            auto &buf = scratch.get();
             details::os::wstr_to_utf8buf(wstring_view_t(wbuf.data(), wbuf.size()), buf);
             details::log_msg log_msg(loc, name_, lvl, string_view_t(buf.data(), buf.size()));
             log_it_(log_msg, log_enabled, traceback_enabled);
@@ -409,10 +515,26 @@ protected:
     // and save backtrace (if backtrace is enabled).
     void log_it_(const details::log_msg &log_msg, bool log_enabled, bool traceback_enabled);
     virtual void sink_it_(const details::log_msg &msg);
+    // msg's payload holds the serialized format string and arguments, to be formatted with format_fn.
+    // the default formats them right away.
+    virtual void sink_deferred_(const details::log_msg &msg, details::deferred_format_fn format_fn);
     virtual void flush_();
     void dump_backtrace_();
     bool should_flush_(const details::log_msg &msg);
 
+    // number of sinks that want the arguments serialized
+    size_t serialized_sinks_() const
+    {
+        auto n = serialized_sinks_n_.load(std::memory_order_relaxed);
+        if (n == sinks_changed_ || counted_sinks_size_.load(std::memory_order_relaxed) != sinks_.size() ||
+            counted_sinks_data_.load(std::memory_order_relaxed) != sinks_.data())
+        {
+            return count_serialized_sinks_();
+        }
+        return n;
+    }
+    size_t count_serialized_sinks_() const;
+
     // handle errors during logging.
     // default handler prints the error to stderr at max rate of 1 message/sec.
     void err_handler_(const std::string &msg);
@@ -420,6 +542,199 @@ protected:
 
 void swap(logger &a, logger &b);
 
+namespace details {
+// SPDLOG_LOGGER_CALL(..): the logger's log(), skipped right away if the call site is known to be disabled for it.
+// the overloads mirror logger::log(source_loc, ..).
+// the macro's logger argument goes through callsite_target(): a (smart) pointer to a logger is used as the logger.
+// anything else with ->log(..), e.g. a wrapper or handle type, gets wrapped in a callsite_fallback,
+// and is called as (logger)->log(..), without the call site cache.
+
+template<typename L, typename = void>
+struct is_logger_ptr : std::false_type
+{};
+
+template<typename L>
+struct is_logger_ptr<L, typename std::enable_if<std::is_convertible<decltype(&*std::declval<L &>()), logger *>::value>::type>
+    : std::true_type
+{};
+
+template<typename T>
+struct callsite_fallback
+{
+    T &target;
+};
+
+template<typename L>
+inline typename std::enable_if<is_logger_ptr<L>::value, logger &>::type callsite_target(L &&l)
+{
+    return *l;
+}
+
+template<typename L>
+inline typename std::enable_if<!is_logger_ptr<L>::value, callsite_fallback<typename std::remove_reference<L>::type>>::type callsite_target(
+    L &&l)
+{
+    return {l};
+}
+
+// what SPDLOG_LOGGER_CALL(..) uses of the logger beyond its public interface
+struct callsite_access
+{
+    static size_t token(const logger &l)
+    {
+        return l.callsite_token_.load(std::memory_order_relaxed);
+    }
+
+    template<typename S, typename... Args>
+    static void log(logger &l, source_loc loc, level::level_enum lvl, bool log_enabled, bool traceback_enabled, const S &fmt, Args &...args)
+    {
+        l.log_checked_(loc, lvl, log_enabled, traceback_enabled, fmt, args...);
+    }
+
+    // a message without arguments, logged as logger::log(source_loc, level::level_enum, string_view_t) does
+    static void log_message(logger &l, source_loc loc, level::level_enum lvl, bool log_enabled, bool traceback_enabled, string_view_t msg)
+    {
+        details::log_msg log_msg(loc, l.name_, lvl, msg);
+        l.log_it_(log_msg, log_enabled, traceback_enabled);
+    }
+};
+
+// checks the logger's levels, for a call through a site not known to be disabled for it.
+// token is the logger's, read before. caches the site as disabled if it is.
+// registers the site on its first call, and sets loc.callsite_id to its id.
+inline bool callsite_enabled(callsite &site, const logger &l, size_t token, source_loc &loc, level::level_enum lvl, string_view_t fmt,
+    bool &log_enabled, bool &traceback_enabled)
+{
+    // pairs with the release of the logger's new token: a new token comes with the new levels
+    std::atomic_thread_fence(std::memory_order_acquire);
+    log_enabled = l.should_log(lvl);
+    traceback_enabled = l.should_backtrace();
+    auto id = site.id();
+    if (id == 0)
+    {
+        site.register_site(loc, lvl, fmt);
+        id = site.id();
+    }
+    if (!log_enabled && !traceback_enabled)
+    {
+        site.cache_disabled(token, lvl);
+        return false;
+    }
+    loc.callsite_id = id;
+    return true;
+}
+
+template<typename... Args>
+inline void log_at(callsite &site, logger &l, source_loc loc, level::level_enum lvl, format_string_t<Args...> fmt, Args &&...args)
+{
+    auto token = callsite_access::token(l);
+    bool log_enabled, traceback_enabled;
+    if (site.disabled_for(token, lvl) ||
+        !callsite_enabled(site, l, token, loc, lvl, to_string_view(fmt), log_enabled, traceback_enabled))
+    {
+        return;
+    }
+    callsite_access::log(l, loc, lvl, log_enabled, traceback_enabled, to_string_view(fmt), args...);
+}
+
+template<class T, typename std::enable_if<!is_convertible_to_any_format_string<const T &>::value &&
+                                              !is_compiled_format_string<T>::value,
+                      int>::type = 0>
+inline void log_at(callsite &site, logger &l, source_loc loc, level::level_enum lvl, const T &msg)
+{
+    auto token = callsite_access::token(l);
+    bool log_enabled, traceback_enabled;
+    if (site.disabled_for(token, lvl) || !callsite_enabled(site, l, token, loc, lvl, "{}", log_enabled, traceback_enabled))
+    {
+        return;
+    }
+    callsite_access::log(l, loc, lvl, log_enabled, traceback_enabled, string_view_t("{}"), msg);
+}
+
+inline void log_at(callsite &site, logger &l, source_loc loc, level::level_enum lvl, string_view_t msg)
+{
+    auto token = callsite_access::token(l);
+    bool log_enabled, traceback_enabled;
+    if (site.disabled_for(token, lvl) || !callsite_enabled(site, l, token, loc, lvl, msg, log_enabled, traceback_enabled))
+    {
+        return;
+    }
+    callsite_access::log_message(l, loc, lvl, log_enabled, traceback_enabled, msg);
+}
+
+#ifdef SPDLOG_WCHAR_TO_UTF8_SUPPORT
+// the hash of wide format strings is not computed
+template<typename... Args>
+inline void log_at(callsite &site, logger &l, source_loc loc, level::level_enum lvl, wformat_string_t<Args...> fmt, Args &&...args)
+{
+    auto token = callsite_access::token(l);
+    bool log_enabled, traceback_enabled;
+    if (site.disabled_for(token, lvl) ||
+        !callsite_enabled(site, l, token, loc, lvl, string_view_t{}, log_enabled, traceback_enabled))
+    {
+        return;
+    }
+    l.log(loc, lvl, fmt, std::forward<Args>(args)...);
+}
+
+inline void log_at(callsite &site, logger &l, source_loc loc, level::level_enum lvl, wstring_view_t msg)
+{
+    auto token = callsite_access::token(l);
+    bool log_enabled, traceback_enabled;
+    if (site.disabled_for(token, lvl) ||
+        !callsite_enabled(site, l, token, loc, lvl, string_view_t{}, log_enabled, traceback_enabled))
+    {
+        return;
+    }
+    l.log(loc, lvl, msg);
+}
+#endif
+
+template<typename T, typename... Args>
+inline void log_at(callsite &, callsite_fallback<T> l, source_loc loc, level::level_enum lvl, format_string_t<Args...> fmt, Args &&...args)
+{
+    l.target->log(loc, lvl, fmt, std::forward<Args>(args)...);
+}
+
+// a message without arguments is passed on as it is
+template<typename T, class M>
+inline void log_at(callsite &, callsite_fallback<T> l, source_loc loc, level::level_enum lvl, const M &msg)
+{
+    l.target->log(loc, lvl, msg);
+}
+
+#ifdef SPDLOG_WCHAR_TO_UTF8_SUPPORT
+template<typename T, typename... Args>
+inline void log_at(callsite &, callsite_fallback<T> l, source_loc loc, level::level_enum lvl, wformat_string_t<Args...> fmt, Args &&...args)
+{
+    l.target->log(loc, lvl, fmt, std::forward<Args>(args)...);
+}
+#endif
+
+#ifdef SPDLOG_COMPILED_FORMAT
+// with SPDLOG_COMPILED_FORMAT: log with the compiled format string, dropping the literal it was made of.
+template<typename S, typename... Args>
+inline void log_compiled(
+    callsite &site, logger &l, source_loc loc, level::level_enum lvl, const S &compiled, string_view_t fmt, Args &&...args)
+{
+    auto token = callsite_access::token(l);
+    bool log_enabled, traceback_enabled;
+    if (site.disabled_for(token, lvl) || !callsite_enabled(site, l, token, loc, lvl, fmt, log_enabled, traceback_enabled))
+    {
+        return;
+    }
+    callsite_access::log(l, loc, lvl, log_enabled, traceback_enabled, compiled, args...);
+}
+
+template<typename T, typename S, typename... Args>
+inline void log_compiled(
+    callsite &, callsite_fallback<T> l, source_loc loc, level::level_enum lvl, const S &compiled, string_view_t, Args &&...args)
+{
+    l.target->log(loc, lvl, compiled, std::forward<Args>(args)...);
+}
+#endif
+} // namespace details
+
 } // namespace spdlog
 
 #ifdef SPDLOG_HEADER_ONLY
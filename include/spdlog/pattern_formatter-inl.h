@@ -24,6 +24,7 @@
 #include <mutex>
 #include <string>
 #include <thread>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -595,20 +596,20 @@ template<typename ScopedPadder>
 class z_formatter final : public flag_formatter
 {
 public:
-    explicit z_formatter(padding_info padinfo)
+    z_formatter(padding_info padinfo, const cached_time &time)
         : flag_formatter(padinfo)
+        , time_(time)
     {}
 
-    z_formatter() = default;
     z_formatter(const z_formatter &) = delete;
     z_formatter &operator=(const z_formatter &) = delete;
 
-    void format(const details::log_msg &msg, const std::tm &tm_time, memory_buf_t &dest) override
+    void format(const details::log_msg &, const std::tm &, memory_buf_t &dest) override
     {
         const size_t field_size = 6;
         ScopedPadder p(field_size, padinfo_, dest);
 
-        auto total_minutes = get_cached_offset(msg, tm_time);
+        auto total_minutes = time_.utc_offset_minutes;
         bool is_negative = total_minutes < 0;
         if (is_negative)
         {
@@ -626,19 +627,8 @@ public:
     }
 
 private:
-    log_clock::time_point last_update_{std::chrono::seconds(0)};
-    int offset_minutes_{0};
-
-    int get_cached_offset(const log_msg &msg, const std::tm &tm_time)
-    {
-        // refresh every 10 seconds
-        if (msg.time - last_update_ >= std::chrono::seconds(10))
-        {
-            offset_minutes_ = os::utc_minutes_offset(tm_time);
-            last_update_ = msg.time;
-        }
-        return offset_minutes_;
-    }
+    // the pattern_formatter's, for the message's second
+    const cached_time &time_;
 };
 
 // Thread id
@@ -654,7 +644,7 @@ public:
     {
         const auto field_size = ScopedPadder::count_digits(msg.thread_id);
         ScopedPadder p(field_size, padinfo_, dest);
-        fmt_helper::append_int(msg.thread_id, dest);
+        fmt_helper::append_uint(msg.thread_id, dest);
     }
 };
 
@@ -672,7 +662,7 @@ public:
         const auto pid = static_cast<uint32_t>(details::os::pid());
         auto field_size = ScopedPadder::count_digits(pid);
         ScopedPadder p(field_size, padinfo_, dest);
-        fmt_helper::append_int(pid, dest);
+        fmt_helper::append_uint(pid, dest);
     }
 };
 
@@ -934,45 +924,19 @@ private:
 class full_formatter final : public flag_formatter
 {
 public:
-    explicit full_formatter(padding_info padinfo)
+    full_formatter(padding_info padinfo, const cached_time &time)
         : flag_formatter(padinfo)
+        , time_(time)
     {}
 
-    void format(const details::log_msg &msg, const std::tm &tm_time, memory_buf_t &dest) override
+    void format(const details::log_msg &msg, const std::tm &, memory_buf_t &dest) override
     {
-        using std::chrono::duration_cast;
         using std::chrono::milliseconds;
-        using std::chrono::seconds;
-
-        // cache the date/time part for the next second.
-        auto duration = msg.time.time_since_epoch();
-        auto secs = duration_cast<seconds>(duration);
-
-        if (cache_timestamp_ != secs || cached_datetime_.size() == 0)
-        {
-            cached_datetime_.clear();
-            cached_datetime_.push_back('[');
-            fmt_helper::append_int(tm_time.tm_year + 1900, cached_datetime_);
-            cached_datetime_.push_back('-');
 
-            fmt_helper::pad2(tm_time.tm_mon + 1, cached_datetime_);
-            cached_datetime_.push_back('-');
-
-            fmt_helper::pad2(tm_time.tm_mday, cached_datetime_);
-            cached_datetime_.push_back(' ');
-
-            fmt_helper::pad2(tm_time.tm_hour, cached_datetime_);
-            cached_datetime_.push_back(':');
-
-            fmt_helper::pad2(tm_time.tm_min, cached_datetime_);
-            cached_datetime_.push_back(':');
-
-            fmt_helper::pad2(tm_time.tm_sec, cached_datetime_);
-            cached_datetime_.push_back('.');
-
-            cache_timestamp_ = secs;
-        }
-        dest.append(cached_datetime_.begin(), cached_datetime_.end());
+        // the date/time part is rendered once per second by the timestamp_cache
+        dest.push_back('[');
+        fmt_helper::append_string_view(time_.datetime_view(), dest);
+        dest.push_back('.');
 
         auto millis = fmt_helper::time_fraction<milliseconds>(msg.time);
         fmt_helper::pad3(static_cast<uint32_t>(millis.count()), dest);
@@ -1013,10 +977,183 @@ public:
     }
 
 private:
+    // the pattern_formatter's, for the message's second
+    const cached_time &time_;
+};
+
+// The formatters that pattern_formatter::format() calls through a switch on their type instead of virtually,
+// so their format() gets inlined. The others (custom and elapsed time flags) are called virtually.
+// The date and time flags that only depend on the second of the message time:
+#define SPDLOG_SECONDS_FLAG_FORMATTERS_(X)                                                                                                 \
+    X(a_formatter)                                                                                                                         \
+    X(A_formatter)                                                                                                                         \
+    X(b_formatter)                                                                                                                         \
+    X(B_formatter)                                                                                                                         \
+    X(c_formatter)                                                                                                                         \
+    X(C_formatter)                                                                                                                         \
+    X(D_formatter)                                                                                                                         \
+    X(Y_formatter)                                                                                                                         \
+    X(m_formatter)                                                                                                                         \
+    X(d_formatter)                                                                                                                         \
+    X(H_formatter)                                                                                                                         \
+    X(I_formatter)                                                                                                                         \
+    X(M_formatter)                                                                                                                         \
+    X(S_formatter)                                                                                                                         \
+    X(p_formatter)                                                                                                                         \
+    X(r_formatter)                                                                                                                         \
+    X(R_formatter)                                                                                                                         \
+    X(T_formatter)                                                                                                                         \
+    X(z_formatter)
+
+#define SPDLOG_OTHER_FLAG_FORMATTERS_(X)                                                                                                   \
+    X(name_formatter)                                                                                                                      \
+    X(level_formatter)                                                                                                                     \
+    X(short_level_formatter)                                                                                                               \
+    X(e_formatter)                                                                                                                         \
+    X(f_formatter)                                                                                                                         \
+    X(F_formatter)                                                                                                                         \
+    X(E_formatter)                                                                                                                         \
+    X(t_formatter)                                                                                                                         \
+    X(pid_formatter)                                                                                                                       \
+    X(v_formatter)                                                                                                                         \
+    X(source_location_formatter)                                                                                                           \
+    X(source_filename_formatter)                                                                                                           \
+    X(short_filename_formatter)                                                                                                            \
+    X(source_linenum_formatter)                                                                                                            \
+    X(source_funcname_formatter)
+
+#define SPDLOG_PADDED_FLAG_FORMATTERS_(X)                                                                                                  \
+    SPDLOG_SECONDS_FLAG_FORMATTERS_(X)                                                                                                     \
+    SPDLOG_OTHER_FLAG_FORMATTERS_(X)
+
+#define SPDLOG_FLAG_FORMATTERS_(X)                                                                                                         \
+    X(ch_formatter)                                                                                                                        \
+    X(aggregate_formatter)                                                                                                                 \
+    X(color_start_formatter)                                                                                                               \
+    X(color_stop_formatter)                                                                                                                \
+    X(full_formatter)                                                                                                                      \
+    X(seconds_formatter)
+
+// a run of per second steps (e.g. "[%Y-%m-%d %H:%M:%S."), formatted once per second and then copied.
+// the steps' formatters are owned by the pattern_formatter.
+class seconds_formatter final : public flag_formatter
+{
+public:
+    explicit seconds_formatter(std::vector<pattern_step> steps)
+        : steps_(std::move(steps))
+    {}
+
+    void format(const details::log_msg &msg, const std::tm &tm_time, memory_buf_t &dest) override;
+
+private:
+    std::vector<pattern_step> steps_;
     std::chrono::seconds cache_timestamp_{0};
-    memory_buf_t cached_datetime_;
+    bool cached_ = false;
+    memory_buf_t cached_text_;
 };
 
+#define SPDLOG_PADDED_FLAG_OP_(F) F, F##_padded,
+#define SPDLOG_FLAG_OP_(F) F,
+enum class flag_op : unsigned char
+{
+    call, // virtual call
+    SPDLOG_PADDED_FLAG_FORMATTERS_(SPDLOG_PADDED_FLAG_OP_) SPDLOG_FLAG_FORMATTERS_(SPDLOG_FLAG_OP_)
+};
+#undef SPDLOG_PADDED_FLAG_OP_
+#undef SPDLOG_FLAG_OP_
+
+template<typename T>
+struct flag_op_of : std::integral_constant<flag_op, flag_op::call>
+{};
+
+#define SPDLOG_PADDED_FLAG_OP_(F)                                                                                                          \
+    template<>                                                                                                                             \
+    struct flag_op_of<F<null_scoped_padder>> : std::integral_constant<flag_op, flag_op::F>                                                 \
+    {};                                                                                                                                    \
+    template<>                                                                                                                             \
+    struct flag_op_of<F<scoped_padder>> : std::integral_constant<flag_op, flag_op::F##_padded>                                             \
+    {};
+#define SPDLOG_FLAG_OP_(F)                                                                                                                 \
+    template<>                                                                                                                             \
+    struct flag_op_of<F> : std::integral_constant<flag_op, flag_op::F>                                                                     \
+    {};
+SPDLOG_PADDED_FLAG_FORMATTERS_(SPDLOG_PADDED_FLAG_OP_)
+SPDLOG_FLAG_FORMATTERS_(SPDLOG_FLAG_OP_)
+#undef SPDLOG_PADDED_FLAG_OP_
+#undef SPDLOG_FLAG_OP_
+
+// whether the step's output only depends on the second of the message time (and not on the rest of the message)
+inline bool per_second_step(const pattern_step &step)
+{
+#define SPDLOG_SECONDS_FLAG_CASE_(F)                                                                                                       \
+    case flag_op::F:                                                                                                                       \
+    case flag_op::F##_padded:
+    switch (step.op)
+    {
+        SPDLOG_SECONDS_FLAG_FORMATTERS_(SPDLOG_SECONDS_FLAG_CASE_)
+    case flag_op::ch_formatter:
+    case flag_op::aggregate_formatter:
+        return true;
+    default:
+        return false;
+    }
+#undef SPDLOG_SECONDS_FLAG_CASE_
+}
+
+// non virtual call of T::format()
+template<typename T>
+inline void call_format(flag_formatter *f, const details::log_msg &msg, const std::tm &tm_time, memory_buf_t &dest)
+{
+    static_cast<T *>(f)->T::format(msg, tm_time, dest);
+}
+
+inline void format_steps(const std::vector<pattern_step> &steps, const details::log_msg &msg, const std::tm &tm_time, memory_buf_t &dest)
+{
+#define SPDLOG_PADDED_FLAG_CASE_(F)                                                                                                        \
+    case flag_op::F:                                                                                                                       \
+        call_format<F<null_scoped_padder>>(step.formatter, msg, tm_time, dest);                                                            \
+        break;                                                                                                                             \
+    case flag_op::F##_padded:                                                                                                              \
+        call_format<F<scoped_padder>>(step.formatter, msg, tm_time, dest);                                                                 \
+        break;
+#define SPDLOG_FLAG_CASE_(F)                                                                                                               \
+    case flag_op::F:                                                                                                                       \
+        call_format<F>(step.formatter, msg, tm_time, dest);                                                                                \
+        break;
+
+    for (auto &step : steps)
+    {
+        switch (step.op)
+        {
+            SPDLOG_PADDED_FLAG_FORMATTERS_(SPDLOG_PADDED_FLAG_CASE_)
+            SPDLOG_FLAG_FORMATTERS_(SPDLOG_FLAG_CASE_)
+        default:
+            step.formatter->format(msg, tm_time, dest);
+            break;
+        }
+    }
+#undef SPDLOG_PADDED_FLAG_CASE_
+#undef SPDLOG_FLAG_CASE_
+}
+
+inline void seconds_formatter::format(const details::log_msg &msg, const std::tm &tm_time, memory_buf_t &dest)
+{
+    auto secs = std::chrono::duration_cast<std::chrono::seconds>(msg.time.time_since_epoch());
+    if (cache_timestamp_ != secs || !cached_)
+    {
+        cached_text_.clear();
+        format_steps(steps_, msg, tm_time, cached_text_);
+        cache_timestamp_ = secs;
+        cached_ = true;
+    }
+    fmt_helper::append_string_view(string_view_t(cached_text_.data(), cached_text_.size()), dest);
+}
+
+#undef SPDLOG_SECONDS_FLAG_FORMATTERS_
+#undef SPDLOG_OTHER_FLAG_FORMATTERS_
+#undef SPDLOG_PADDED_FLAG_FORMATTERS_
+#undef SPDLOG_FLAG_FORMATTERS_
+
 } // namespace details
 
 SPDLOG_INLINE pattern_formatter::pattern_formatter(
@@ -1025,10 +1162,8 @@ SPDLOG_INLINE pattern_formatter::pattern_formatter(
     , eol_(std::move(eol))
     , pattern_time_type_(time_type)
     , need_localtime_(false)
-    , last_log_secs_(0)
     , custom_handlers_(std::move(custom_user_flags))
 {
-    std::memset(&cached_tm_, 0, sizeof(cached_tm_));
     compile_pattern_(pattern_);
 }
 
@@ -1038,10 +1173,9 @@ SPDLOG_INLINE pattern_formatter::pattern_formatter(pattern_time_type time_type,
     , eol_(std::move(eol))
     , pattern_time_type_(time_type)
     , need_localtime_(true)
-    , last_log_secs_(0)
 {
-    std::memset(&cached_tm_, 0, sizeof(cached_tm_));
-    formatters_.push_back(details::make_unique<details::full_formatter>(details::padding_info{}));
+    push_formatter_(details::make_unique<details::full_formatter>(details::padding_info{}, cached_time_));
+    update_format_key_();
 }
 
 SPDLOG_INLINE std::unique_ptr<formatter> pattern_formatter::clone() const
@@ -1065,21 +1199,22 @@ SPDLOG_INLINE void pattern_formatter::format(const details::log_msg &msg, memory
     if (need_localtime_)
     {
         const auto secs = std::chrono::duration_cast<std::chrono::seconds>(msg.time.time_since_epoch());
-        if (secs != last_log_secs_)
+        if (secs != cached_time_.secs)
         {
-            cached_tm_ = get_time_(msg);
-            last_log_secs_ = secs;
+            details::timestamp_cache::instance().get(secs, pattern_time_type_, cached_time_);
         }
     }
 
-    for (auto &f : formatters_)
-    {
-        f->format(msg, cached_tm_, dest);
-    }
+    details::format_steps(steps_, msg, cached_time_.tm, dest);
     // write eol
     details::fmt_helper::append_string_view(eol_, dest);
 }
 
+SPDLOG_INLINE string_view_t pattern_formatter::format_key() const
+{
+    return format_key_;
+}
+
 SPDLOG_INLINE void pattern_formatter::set_pattern(std::string pattern)
 {
     pattern_ = std::move(pattern);
@@ -1090,15 +1225,7 @@ SPDLOG_INLINE void pattern_formatter::set_pattern(std::string pattern)
 SPDLOG_INLINE void pattern_formatter::need_localtime(bool need)
 {
     need_localtime_ = need;
-}
-
-SPDLOG_INLINE std::tm pattern_formatter::get_time_(const details::log_msg &msg)
-{
-    if (pattern_time_type_ == pattern_time_type::local)
-    {
-        return details::os::localtime(log_clock::to_time_t(msg.time));
-    }
-    return details::os::gmtime(log_clock::to_time_t(msg.time));
+    update_format_key_();
 }
 
 template<typename Padder>
@@ -1110,7 +1237,8 @@ SPDLOG_INLINE void pattern_formatter::handle_flag_(char flag, details::padding_i
     {
         auto custom_handler = it->second->clone();
         custom_handler->set_padding_info(padding);
-        formatters_.push_back(std::move(custom_handler));
+        push_formatter_(std::move(custom_handler));
+        stateful_flags_ = true;
         return;
     }
 
@@ -1118,194 +1246,198 @@ SPDLOG_INLINE void pattern_formatter::handle_flag_(char flag, details::padding_i
     switch (flag)
     {
     case ('+'): // default formatter
-        formatters_.push_back(details::make_unique<details::full_formatter>(padding));
+        push_formatter_(details::make_unique<details::full_formatter>(padding, cached_time_));
         need_localtime_ = true;
         break;
 
     case 'n': // logger name
-        formatters_.push_back(details::make_unique<details::name_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::name_formatter<Padder>>(padding));
         break;
 
     case 'l': // level
-        formatters_.push_back(details::make_unique<details::level_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::level_formatter<Padder>>(padding));
         break;
 
     case 'L': // short level
-        formatters_.push_back(details::make_unique<details::short_level_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::short_level_formatter<Padder>>(padding));
         break;
 
     case ('t'): // thread id
-        formatters_.push_back(details::make_unique<details::t_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::t_formatter<Padder>>(padding));
         break;
 
     case ('v'): // the message text
-        formatters_.push_back(details::make_unique<details::v_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::v_formatter<Padder>>(padding));
         break;
 
     case ('a'): // weekday
-        formatters_.push_back(details::make_unique<details::a_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::a_formatter<Padder>>(padding));
         need_localtime_ = true;
         break;
 
     case ('A'): // short weekday
-        formatters_.push_back(details::make_unique<details::A_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::A_formatter<Padder>>(padding));
         need_localtime_ = true;
         break;
 
     case ('b'):
     case ('h'): // month
-        formatters_.push_back(details::make_unique<details::b_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::b_formatter<Padder>>(padding));
         need_localtime_ = true;
         break;
 
     case ('B'): // short month
-        formatters_.push_back(details::make_unique<details::B_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::B_formatter<Padder>>(padding));
         need_localtime_ = true;
         break;
 
     case ('c'): // datetime
-        formatters_.push_back(details::make_unique<details::c_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::c_formatter<Padder>>(padding));
         need_localtime_ = true;
         break;
 
     case ('C'): // year 2 digits
-        formatters_.push_back(details::make_unique<details::C_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::C_formatter<Padder>>(padding));
         need_localtime_ = true;
         break;
 
     case ('Y'): // year 4 digits
-        formatters_.push_back(details::make_unique<details::Y_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::Y_formatter<Padder>>(padding));
         need_localtime_ = true;
         break;
 
     case ('D'):
     case ('x'): // datetime MM/DD/YY
-        formatters_.push_back(details::make_unique<details::D_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::D_formatter<Padder>>(padding));
         need_localtime_ = true;
         break;
 
     case ('m'): // month 1-12
-        formatters_.push_back(details::make_unique<details::m_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::m_formatter<Padder>>(padding));
         need_localtime_ = true;
         break;
 
     case ('d'): // day of month 1-31
-        formatters_.push_back(details::make_unique<details::d_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::d_formatter<Padder>>(padding));
         need_localtime_ = true;
         break;
 
     case ('H'): // hours 24
-        formatters_.push_back(details::make_unique<details::H_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::H_formatter<Padder>>(padding));
         need_localtime_ = true;
         break;
 
     case ('I'): // hours 12
-        formatters_.push_back(details::make_unique<details::I_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::I_formatter<Padder>>(padding));
         need_localtime_ = true;
         break;
 
     case ('M'): // minutes
-        formatters_.push_back(details::make_unique<details::M_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::M_formatter<Padder>>(padding));
         need_localtime_ = true;
         break;
 
     case ('S'): // seconds
-        formatters_.push_back(details::make_unique<details::S_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::S_formatter<Padder>>(padding));
         need_localtime_ = true;
         break;
 
     case ('e'): // milliseconds
-        formatters_.push_back(details::make_unique<details::e_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::e_formatter<Padder>>(padding));
         break;
 
     case ('f'): // microseconds
-        formatters_.push_back(details::make_unique<details::f_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::f_formatter<Padder>>(padding));
         break;
 
     case ('F'): // nanoseconds
-        formatters_.push_back(details::make_unique<details::F_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::F_formatter<Padder>>(padding));
         break;
 
     case ('E'): // seconds since epoch
-        formatters_.push_back(details::make_unique<details::E_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::E_formatter<Padder>>(padding));
         break;
 
     case ('p'): // am/pm
-        formatters_.push_back(details::make_unique<details::p_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::p_formatter<Padder>>(padding));
         need_localtime_ = true;
         break;
 
     case ('r'): // 12 hour clock 02:55:02 pm
-        formatters_.push_back(details::make_unique<details::r_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::r_formatter<Padder>>(padding));
         need_localtime_ = true;
         break;
 
     case ('R'): // 24-hour HH:MM time
-        formatters_.push_back(details::make_unique<details::R_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::R_formatter<Padder>>(padding));
         need_localtime_ = true;
         break;
 
     case ('T'):
     case ('X'): // ISO 8601 time format (HH:MM:SS)
-        formatters_.push_back(details::make_unique<details::T_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::T_formatter<Padder>>(padding));
         need_localtime_ = true;
         break;
 
     case ('z'): // timezone
-        formatters_.push_back(details::make_unique<details::z_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::z_formatter<Padder>>(padding, cached_time_));
         need_localtime_ = true;
         break;
 
     case ('P'): // pid
-        formatters_.push_back(details::make_unique<details::pid_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::pid_formatter<Padder>>(padding));
         break;
 
     case ('^'): // color range start
-        formatters_.push_back(details::make_unique<details::color_start_formatter>(padding));
+        push_formatter_(details::make_unique<details::color_start_formatter>(padding));
         break;
 
     case ('$'): // color range end
-        formatters_.push_back(details::make_unique<details::color_stop_formatter>(padding));
+        push_formatter_(details::make_unique<details::color_stop_formatter>(padding));
         break;
 
     case ('@'): // source location (filename:filenumber)
-        formatters_.push_back(details::make_unique<details::source_location_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::source_location_formatter<Padder>>(padding));
         break;
 
     case ('s'): // short source filename - without directory name
-        formatters_.push_back(details::make_unique<details::short_filename_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::short_filename_formatter<Padder>>(padding));
         break;
 
     case ('g'): // full source filename
-        formatters_.push_back(details::make_unique<details::source_filename_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::source_filename_formatter<Padder>>(padding));
         break;
 
     case ('#'): // source line number
-        formatters_.push_back(details::make_unique<details::source_linenum_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::source_linenum_formatter<Padder>>(padding));
         break;
 
     case ('!'): // source funcname
-        formatters_.push_back(details::make_unique<details::source_funcname_formatter<Padder>>(padding));
+        push_formatter_(details::make_unique<details::source_funcname_formatter<Padder>>(padding));
         break;
 
     case ('%'): // % char
-        formatters_.push_back(details::make_unique<details::ch_formatter>('%'));
+        push_formatter_(details::make_unique<details::ch_formatter>('%'));
         break;
 
     case ('u'): // elapsed time since last log message in nanos
-        formatters_.push_back(details::make_unique<details::elapsed_formatter<Padder, std::chrono::nanoseconds>>(padding));
+        push_formatter_(details::make_unique<details::elapsed_formatter<Padder, std::chrono::nanoseconds>>(padding));
+        stateful_flags_ = true;
         break;
 
     case ('i'): // elapsed time since last log message in micros
-        formatters_.push_back(details::make_unique<details::elapsed_formatter<Padder, std::chrono::microseconds>>(padding));
+        push_formatter_(details::make_unique<details::elapsed_formatter<Padder, std::chrono::microseconds>>(padding));
+        stateful_flags_ = true;
         break;
 
     case ('o'): // elapsed time since last log message in millis
-        formatters_.push_back(details::make_unique<details::elapsed_formatter<Padder, std::chrono::milliseconds>>(padding));
+        push_formatter_(details::make_unique<details::elapsed_formatter<Padder, std::chrono::milliseconds>>(padding));
+        stateful_flags_ = true;
         break;
 
     case ('O'): // elapsed time since last log message in seconds
-        formatters_.push_back(details::make_unique<details::elapsed_formatter<Padder, std::chrono::seconds>>(padding));
+        push_formatter_(details::make_unique<details::elapsed_formatter<Padder, std::chrono::seconds>>(padding));
+        stateful_flags_ = true;
         break;
 
     default: // Unknown flag appears as is
@@ -1315,7 +1447,7 @@ SPDLOG_INLINE void pattern_formatter::handle_flag_(char flag, details::padding_i
         {
             unknown_flag->add_ch('%');
             unknown_flag->add_ch(flag);
-            formatters_.push_back((std::move(unknown_flag)));
+            push_formatter_(std::move(unknown_flag));
         }
         // fix issue #1617 (prev char was '!' and should have been treated as funcname flag instead of truncating flag)
         // spdlog::set_pattern("[%10!] %v") => "[      main] some message"
@@ -1323,15 +1455,23 @@ SPDLOG_INLINE void pattern_formatter::handle_flag_(char flag, details::padding_i
         else
         {
             padding.truncate_ = false;
-            formatters_.push_back(details::make_unique<details::source_funcname_formatter<Padder>>(padding));
+            push_formatter_(details::make_unique<details::source_funcname_formatter<Padder>>(padding));
             unknown_flag->add_ch(flag);
-            formatters_.push_back((std::move(unknown_flag)));
+            push_formatter_(std::move(unknown_flag));
         }
 
         break;
     }
 }
 
+template<typename T>
+SPDLOG_INLINE void pattern_formatter::push_formatter_(std::unique_ptr<T> f)
+{
+    auto *raw = f.get();
+    formatters_.push_back(std::move(f));
+    steps_.push_back(details::pattern_step{details::flag_op_of<T>::value, raw});
+}
+
 // Extract given pad spec (e.g. %8X, %=8X, %-8!X, %8!X, %=8!X, %-8!X, %+8!X)
 // Advance the given it pass the end of the padding spec found (if any)
 // Return padding.
@@ -1392,13 +1532,15 @@ SPDLOG_INLINE void pattern_formatter::compile_pattern_(const std::string &patter
     auto end = pattern.end();
     std::unique_ptr<details::aggregate_formatter> user_chars;
     formatters_.clear();
+    steps_.clear();
+    stateful_flags_ = false;
     for (auto it = pattern.begin(); it != end; ++it)
     {
         if (*it == '%')
         {
             if (user_chars) // append user chars found so far
             {
-                formatters_.push_back(std::move(user_chars));
+                push_formatter_(std::move(user_chars));
             }
 
             auto padding = handle_padspec_(++it, end);
@@ -1430,7 +1572,55 @@ SPDLOG_INLINE void pattern_formatter::compile_pattern_(const std::string &patter
     }
     if (user_chars) // append raw chars found so far
     {
-        formatters_.push_back(std::move(user_chars));
+        push_formatter_(std::move(user_chars));
+    }
+    fold_seconds_steps_();
+    update_format_key_();
+}
+
+// replace runs of steps that only depend on the second of the message time with a seconds_formatter,
+// that formats them once per second
+SPDLOG_INLINE void pattern_formatter::fold_seconds_steps_()
+{
+    std::vector<details::pattern_step> folded;
+    for (size_t i = 0; i < steps_.size();)
+    {
+        size_t end = i;
+        bool has_time = false;
+        for (; end < steps_.size() && details::per_second_step(steps_[end]); end++)
+        {
+            has_time = has_time || (steps_[end].op != details::flag_op::aggregate_formatter && steps_[end].op != details::flag_op::ch_formatter);
+        }
+        if (!has_time || end - i < 2)
+        {
+            end = (std::max)(end, i + 1);
+            folded.insert(folded.end(), steps_.begin() + static_cast<std::ptrdiff_t>(i), steps_.begin() + static_cast<std::ptrdiff_t>(end));
+        }
+        else
+        {
+            auto seconds = details::make_unique<details::seconds_formatter>(
+                std::vector<details::pattern_step>(steps_.begin() + static_cast<std::ptrdiff_t>(i), steps_.begin() + static_cast<std::ptrdiff_t>(end)));
+            folded.push_back(details::pattern_step{details::flag_op::seconds_formatter, seconds.get()});
+            formatters_.push_back(std::move(seconds));
+        }
+        i = end;
+    }
+    steps_.swap(folded);
+}
+
+// custom flags and elapsed time flags may format a message differently in another formatter
+SPDLOG_INLINE void pattern_formatter::update_format_key_()
+{
+    format_key_.clear();
+    if (stateful_flags_)
+    {
+        return;
     }
+    format_key_ = std::to_string(pattern_.size());
+    format_key_ += ':';
+    format_key_ += pattern_;
+    format_key_ += eol_;
+    format_key_ += pattern_time_type_ == pattern_time_type::local ? 'l' : 'u';
+    format_key_ += need_localtime_ ? '1' : '0';
 }
 } // namespace spdlog
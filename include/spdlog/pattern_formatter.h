@@ -6,6 +6,7 @@
 #include <spdlog/common.h>
 #include <spdlog/details/log_msg.h>
 #include <spdlog/details/os.h>
+#include <spdlog/details/timestamp_cache.h>
 #include <spdlog/formatter.h>
 
 #include <chrono>
@@ -61,6 +62,16 @@ protected:
     padding_info padinfo_;
 };
 
+// which formatter type a pattern step calls (see pattern_formatter-inl.h)
+enum class flag_op : unsigned char;
+
+// a step of a compiled pattern
+struct pattern_step
+{
+    flag_op op;
+    flag_formatter *formatter;
+};
+
 } // namespace details
 
 class SPDLOG_API custom_flag_formatter : public details::flag_formatter
@@ -90,6 +101,8 @@ public:
 
     std::unique_ptr<formatter> clone() const override;
     void format(const details::log_msg &msg, memory_buf_t &dest) override;
+    // the pattern, eol and time settings. empty if the pattern uses custom or elapsed time flags.
+    string_view_t format_key() const override;
 
     template<typename T, typename... Args>
     pattern_formatter &add_flag(char flag, Args &&...args)
@@ -105,14 +118,19 @@ private:
     std::string eol_;
     pattern_time_type pattern_time_type_;
     bool need_localtime_;
-    std::tm cached_tm_;
-    std::chrono::seconds last_log_secs_;
+    // the message's second, from the timestamp_cache
+    details::cached_time cached_time_;
     std::vector<std::unique_ptr<details::flag_formatter>> formatters_;
+    // formatters_ in pattern order, with their types: format() calls them without virtual dispatch
+    std::vector<details::pattern_step> steps_;
     custom_flags custom_handlers_;
+    bool stateful_flags_ = false; // the pattern has custom or elapsed time flags
+    std::string format_key_;
 
-    std::tm get_time_(const details::log_msg &msg);
     template<typename Padder>
     void handle_flag_(char flag, details::padding_info padding);
+    template<typename T>
+    void push_formatter_(std::unique_ptr<T> f);
 
     // Extract given pad spec (e.g. %8X)
     // Advance the given it pass the end of the padding spec found (if any)
@@ -120,6 +138,8 @@ private:
     static details::padding_info handle_padspec_(std::string::const_iterator &it, std::string::const_iterator end);
 
     void compile_pattern_(const std::string &pattern);
+    void fold_seconds_steps_();
+    void update_format_key_();
 };
 } // namespace spdlog
 
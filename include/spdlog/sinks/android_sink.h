@@ -49,7 +49,7 @@ protected:
         }
         else
         {
-            base_sink<Mutex>::formatter_->format(msg, formatted);
+            base_sink<Mutex>::formatter_->format_shared(msg, formatted);
         }
         formatted.push_back('\0');
         const char *msg_output = formatted.data();
@@ -29,6 +29,13 @@ void SPDLOG_INLINE spdlog::sinks::base_sink<Mutex>::log(const details::log_msg &
     sink_it_(msg);
 }
 
+template<typename Mutex>
+void SPDLOG_INLINE spdlog::sinks::base_sink<Mutex>::log_batch(const details::log_msg *msgs, size_t count)
+{
+    std::lock_guard<Mutex> lock(mutex_);
+    sink_batch_(msgs, count);
+}
+
 template<typename Mutex>
 void SPDLOG_INLINE spdlog::sinks::base_sink<Mutex>::flush()
 {
@@ -50,6 +57,18 @@ void SPDLOG_INLINE spdlog::sinks::base_sink<Mutex>::set_formatter(std::unique_pt
     set_formatter_(std::move(sink_formatter));
 }
 
+template<typename Mutex>
+void SPDLOG_INLINE spdlog::sinks::base_sink<Mutex>::sink_batch_(const details::log_msg *msgs, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (this->should_log(msgs[i].level))
+        {
+            sink_it_(msgs[i]);
+        }
+    }
+}
+
 template<typename Mutex>
 void SPDLOG_INLINE spdlog::sinks::base_sink<Mutex>::set_pattern_(const std::string &pattern)
 {
@@ -5,6 +5,8 @@
 //
 // base sink templated over a mutex (either dummy or real)
 // concrete implementation should override the sink_it_() and flush_()  methods.
+// sinks that can write a batch of messages more efficiently (e.g. one write call)
+// can also override sink_batch_().
 // locking is taken care of in this class - no locking needed by the
 // implementers..
 //
@@ -30,6 +32,7 @@ public:
     base_sink &operator=(base_sink &&) = delete;
 
     void log(const details::log_msg &msg) final;
+    void log_batch(const details::log_msg *msgs, size_t count) final;
     void flush() final;
     void set_pattern(const std::string &pattern) final;
     void set_formatter(std::unique_ptr<spdlog::formatter> sink_formatter) final;
@@ -40,6 +43,8 @@ protected:
     Mutex mutex_;
 
     virtual void sink_it_(const details::log_msg &msg) = 0;
+    // called under the lock. implementations must skip messages for which should_log() is false.
+    virtual void sink_batch_(const details::log_msg *msgs, size_t count);
     virtual void flush_() = 0;
     virtual void set_pattern_(const std::string &pattern);
     virtual void set_formatter_(std::unique_ptr<spdlog::formatter> sink_formatter);
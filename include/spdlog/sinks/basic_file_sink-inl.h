@@ -30,7 +30,22 @@ template<typename Mutex>
 SPDLOG_INLINE void basic_file_sink<Mutex>::sink_it_(const details::log_msg &msg)
 {
     memory_buf_t formatted;
-    base_sink<Mutex>::formatter_->format(msg, formatted);
+    base_sink<Mutex>::formatter_->format_shared(msg, formatted);
+    file_helper_.write(formatted);
+}
+
+// format the whole batch and write it with a single call
+template<typename Mutex>
+SPDLOG_INLINE void basic_file_sink<Mutex>::sink_batch_(const details::log_msg *msgs, size_t count)
+{
+    memory_buf_t formatted;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (this->should_log(msgs[i].level))
+        {
+            base_sink<Mutex>::formatter_->format_shared(msgs[i], formatted);
+        }
+    }
     file_helper_.write(formatted);
 }
 
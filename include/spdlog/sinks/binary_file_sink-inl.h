@@ -0,0 +1,202 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#ifndef SPDLOG_HEADER_ONLY
+#    include <spdlog/sinks/binary_file_sink.h>
+#endif
+
+#include <spdlog/common.h>
+#include <spdlog/details/binary_format.h>
+#include <spdlog/details/deferred_format.h>
+
+#include <chrono>
+#include <functional>
+
+namespace spdlog {
+namespace sinks {
+
+namespace binary_detail {
+inline uint64_t hash(string_view_t str, uint64_t hash = 14695981039346656037ULL)
+{
+    for (auto c : str)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+} // namespace binary_detail
+
+template<typename Mutex>
+SPDLOG_INLINE binary_file_sink<Mutex>::binary_file_sink(const filename_t &filename, bool truncate, const file_event_handlers &event_handlers)
+    : file_helper_{event_handlers}
+{
+    file_helper_.open(filename, truncate);
+    // appending to an existing file starts a new dictionary
+    details::binary::put_header(records_);
+    file_helper_.write(records_);
+    records_.clear();
+    this->wants_serialized_ = true;
+}
+
+template<typename Mutex>
+SPDLOG_INLINE const filename_t &binary_file_sink<Mutex>::filename() const
+{
+    return file_helper_.filename();
+}
+
+template<typename Mutex>
+SPDLOG_INLINE void binary_file_sink<Mutex>::sink_it_(const details::log_msg &msg)
+{
+    records_.clear();
+    encode_(msg);
+    file_helper_.write(records_);
+}
+
+template<typename Mutex>
+SPDLOG_INLINE void binary_file_sink<Mutex>::sink_batch_(const details::log_msg *msgs, size_t count)
+{
+    records_.clear();
+    for (size_t i = 0; i < count; i++)
+    {
+        if (this->should_log(msgs[i].level))
+        {
+            encode_(msgs[i]);
+        }
+    }
+    file_helper_.write(records_);
+}
+
+template<typename Mutex>
+SPDLOG_INLINE void binary_file_sink<Mutex>::flush_()
+{
+    file_helper_.flush();
+}
+
+// append the message's record to records_, preceded by the dictionary records it needs
+template<typename Mutex>
+SPDLOG_INLINE void binary_file_sink<Mutex>::encode_(const details::log_msg &msg)
+{
+    using details::binary::put;
+    string_view_t serialized = msg.serialized;
+    if (serialized.size() == 0)
+    {
+        fallback_.clear();
+        details::serialize_args(fallback_, "{}", msg.payload);
+        serialized = string_view_t(fallback_.data(), fallback_.size());
+    }
+
+    const char *args = serialized.data();
+    auto fmt = details::deferred::string_arg::read(args);
+    auto args_size = serialized.size() - static_cast<size_t>(args - serialized.data());
+    auto format_id = format_id_(fmt, msg.source);
+    auto logger_id = logger_id_(msg.logger_name);
+
+    put(records_, details::binary::record_type::message);
+    put(records_, static_cast<uint8_t>(msg.level));
+    put(records_, format_id);
+    put(records_, logger_id);
+    put(records_, static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(msg.time.time_since_epoch()).count()));
+    put(records_, static_cast<uint64_t>(msg.thread_id));
+    put(records_, static_cast<uint32_t>(args_size));
+    records_.append(args, args + args_size);
+}
+
+// source locations refer to static strings (see log_msg_buffer): they are compared by address.
+// entries are looked up by location if there is one (a log call site mostly uses a single format string),
+// so the format string is only compared, not hashed. messages of a SPDLOG_LOGGER_CALL(..) call site are
+// looked up by the site's id first.
+template<typename Mutex>
+SPDLOG_INLINE uint32_t binary_file_sink<Mutex>::format_id_(string_view_t fmt, const source_loc &loc)
+{
+    auto matches = [this, fmt, &loc](uint32_t id) {
+        auto &entry = formats_[id - 1];
+        return entry.loc.filename == loc.filename && entry.loc.line == loc.line && entry.loc.funcname == loc.funcname &&
+               string_view_t(entry.fmt) == fmt;
+    };
+
+    uint32_t *site_format = nullptr;
+    if (loc.callsite_id != 0)
+    {
+        if (callsite_formats_.size() <= loc.callsite_id)
+        {
+            callsite_formats_.resize(loc.callsite_id + 1, 0);
+        }
+        site_format = &callsite_formats_[loc.callsite_id];
+        if (*site_format != 0 && matches(*site_format))
+        {
+            return *site_format;
+        }
+    }
+
+    uint64_t hash;
+    if (loc.empty())
+    {
+        hash = binary_detail::hash(fmt);
+    }
+    else
+    {
+        hash = std::hash<const void *>()(loc.filename);
+        hash ^= std::hash<const void *>()(loc.funcname) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+        hash ^= static_cast<uint64_t>(static_cast<uint32_t>(loc.line)) << 32;
+    }
+
+    // the entries of the location (several if it used several format strings), or colliding ones
+    uint32_t id = 0;
+    auto range = format_ids_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (matches(it->second))
+        {
+            id = it->second;
+            break;
+        }
+    }
+
+    if (id == 0)
+    {
+        formats_.push_back(format_entry{std::string(fmt.data(), fmt.size()), loc});
+        id = static_cast<uint32_t>(formats_.size());
+        format_ids_.emplace(hash, id);
+
+        details::binary::put(records_, details::binary::record_type::format);
+        details::binary::put(records_, id);
+        details::binary::put(records_, static_cast<int32_t>(loc.line));
+        details::binary::put_string(records_, loc.filename ? loc.filename : "");
+        details::binary::put_string(records_, loc.funcname ? loc.funcname : "");
+        details::binary::put_string(records_, fmt);
+    }
+    if (site_format != nullptr)
+    {
+        *site_format = id;
+    }
+    return id;
+}
+
+template<typename Mutex>
+SPDLOG_INLINE uint32_t binary_file_sink<Mutex>::logger_id_(string_view_t name)
+{
+    auto hash = binary_detail::hash(name);
+    auto range = logger_ids_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (string_view_t(loggers_[it->second - 1]) == name)
+        {
+            return it->second;
+        }
+    }
+
+    loggers_.emplace_back(name.data(), name.size());
+    auto id = static_cast<uint32_t>(loggers_.size());
+    logger_ids_.emplace(hash, id);
+
+    details::binary::put(records_, details::binary::record_type::logger);
+    details::binary::put(records_, id);
+    details::binary::put_string(records_, name);
+    return id;
+}
+
+} // namespace sinks
+} // namespace spdlog
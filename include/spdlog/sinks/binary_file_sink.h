@@ -0,0 +1,91 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#include <spdlog/details/file_helper.h>
+#include <spdlog/details/null_mutex.h>
+#include <spdlog/sinks/base_sink.h>
+#include <spdlog/details/synchronous_factory.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace spdlog {
+namespace sinks {
+/*
+ * File sink storing messages unformatted: the format string and source location of each log call once,
+ * then for each message its level, time, thread id and arguments (see details/binary_format.h).
+ * Read the file back with binary_decoder, which formats the messages with a given pattern.
+ *
+ * Log calls with arguments that cannot be serialized (e.g. user types), and messages of async loggers
+ * that also have text sinks, are stored as their formatted text.
+ * The sink's pattern and formatter are not used.
+ */
+template<typename Mutex>
+class binary_file_sink final : public base_sink<Mutex>
+{
+public:
+    explicit binary_file_sink(const filename_t &filename, bool truncate = false, const file_event_handlers &event_handlers = {});
+    const filename_t &filename() const;
+
+protected:
+    void sink_it_(const details::log_msg &msg) override;
+    void sink_batch_(const details::log_msg *msgs, size_t count) override;
+    void flush_() override;
+
+private:
+    struct format_entry
+    {
+        std::string fmt;
+        source_loc loc;
+    };
+
+    details::file_helper file_helper_;
+    memory_buf_t records_;
+    memory_buf_t fallback_;
+    // dictionaries: hash to id (ids are indexes + 1)
+    // formats are keyed by location and format string, hashed by location (or by format string without one)
+    std::unordered_multimap<uint64_t, uint32_t> format_ids_;
+    std::vector<format_entry> formats_;
+    // by details::callsite id (see source_loc::callsite_id): the format id of the site's latest message, or 0
+    std::vector<uint32_t> callsite_formats_;
+    // loggers are keyed by name, hashed by name
+    std::unordered_multimap<uint64_t, uint32_t> logger_ids_;
+    std::vector<std::string> loggers_;
+
+    void encode_(const details::log_msg &msg);
+    uint32_t format_id_(string_view_t fmt, const source_loc &loc);
+    uint32_t logger_id_(string_view_t name);
+};
+
+using binary_file_sink_mt = binary_file_sink<std::mutex>;
+using binary_file_sink_st = binary_file_sink<details::null_mutex>;
+
+} // namespace sinks
+
+//
+// factory functions
+//
+template<typename Factory = spdlog::synchronous_factory>
+inline std::shared_ptr<logger> binary_logger_mt(
+    const std::string &logger_name, const filename_t &filename, bool truncate = false, const file_event_handlers &event_handlers = {})
+{
+    return Factory::template create<sinks::binary_file_sink_mt>(logger_name, filename, truncate, event_handlers);
+}
+
+template<typename Factory = spdlog::synchronous_factory>
+inline std::shared_ptr<logger> binary_logger_st(
+    const std::string &logger_name, const filename_t &filename, bool truncate = false, const file_event_handlers &event_handlers = {})
+{
+    return Factory::template create<sinks::binary_file_sink_st>(logger_name, filename, truncate, event_handlers);
+}
+
+} // namespace spdlog
+
+#ifdef SPDLOG_HEADER_ONLY
+#    include "binary_file_sink-inl.h"
+#endif
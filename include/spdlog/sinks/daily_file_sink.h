@@ -113,7 +113,7 @@ protected:
             rotation_tp_ = next_rotation_tp_();
         }
         memory_buf_t formatted;
-        base_sink<Mutex>::formatter_->format(msg, formatted);
+        base_sink<Mutex>::formatter_->format_shared(msg, formatted);
         file_helper_.write(formatted);
 
         // Do the cleaning only at the end because it might throw on failure.
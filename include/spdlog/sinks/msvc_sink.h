@@ -43,7 +43,7 @@ protected:
             return;
         }
         memory_buf_t formatted;
-        base_sink<Mutex>::formatter_->format(msg, formatted);
+        base_sink<Mutex>::formatter_->format_shared(msg, formatted);
         formatted.push_back('\0'); // add a null terminator for OutputDebugString
 #    if defined(SPDLOG_WCHAR_TO_UTF8_SUPPORT)
         wmemory_buf_t wformatted;
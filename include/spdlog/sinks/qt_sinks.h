@@ -49,7 +49,7 @@ protected:
     void sink_it_(const details::log_msg &msg) override
     {
         memory_buf_t formatted;
-        base_sink<Mutex>::formatter_->format(msg, formatted);
+        base_sink<Mutex>::formatter_->format_shared(msg, formatted);
         const string_view_t str = string_view_t(formatted.data(), formatted.size());
         QMetaObject::invokeMethod(qt_object_, meta_method_.c_str(), Qt::AutoConnection,
             Q_ARG(QString, QString::fromUtf8(str.data(), static_cast<int>(str.size())).trimmed()));
@@ -158,7 +158,7 @@ protected:
     void sink_it_(const details::log_msg &msg) override
     {
         memory_buf_t formatted;
-        base_sink<Mutex>::formatter_->format(msg, formatted);
+        base_sink<Mutex>::formatter_->format_shared(msg, formatted);
 
         const string_view_t str = string_view_t(formatted.data(), formatted.size());
         // apply the color to the color range in the formatted message.
@@ -75,7 +75,7 @@ template<typename Mutex>
 SPDLOG_INLINE void rotating_file_sink<Mutex>::sink_it_(const details::log_msg &msg)
 {
     memory_buf_t formatted;
-    base_sink<Mutex>::formatter_->format(msg, formatted);
+    base_sink<Mutex>::formatter_->format_shared(msg, formatted);
     auto new_size = current_size_ + formatted.size();
 
     // rotate if the new estimated file size exceeds max size.
@@ -14,6 +14,10 @@ class SPDLOG_API sink
 public:
     virtual ~sink() = default;
     virtual void log(const details::log_msg &msg) = 0;
+    // log count messages at once (e.g. a batch drained from the async queue).
+    // messages below the sink's level are skipped.
+    // the default implementation calls log() for each of them.
+    virtual void log_batch(const details::log_msg *msgs, size_t count);
     virtual void flush() = 0;
     virtual void set_pattern(const std::string &pattern) = 0;
     virtual void set_formatter(std::unique_ptr<spdlog::formatter> sink_formatter) = 0;
@@ -22,9 +26,17 @@ public:
     level::level_enum level() const;
     bool should_log(level::level_enum msg_level) const;
 
+    // true if the sink stores the arguments of log calls unformatted (log_msg::serialized).
+    // loggers then serialize the arguments if they can, and format them only for their other sinks.
+    bool wants_serialized() const
+    {
+        return wants_serialized_;
+    }
+
 protected:
     // sink log level - default is all
     level_t level_{level::trace};
+    bool wants_serialized_{false};
 };
 
 } // namespace sinks
@@ -59,7 +59,7 @@ SPDLOG_INLINE void stdout_sink_base<ConsoleMutex>::log(const details::log_msg &m
     }
     std::lock_guard<mutex_t> lock(mutex_);
     memory_buf_t formatted;
-    formatter_->format(msg, formatted);
+    formatter_->format_shared(msg, formatted);
     auto size = static_cast<DWORD>(formatted.size());
     DWORD bytes_written = 0;
     bool ok = ::WriteFile(handle_, formatted.data(), size, &bytes_written, nullptr) != 0;
@@ -70,7 +70,7 @@ SPDLOG_INLINE void stdout_sink_base<ConsoleMutex>::log(const details::log_msg &m
 #else
     std::lock_guard<mutex_t> lock(mutex_);
     memory_buf_t formatted;
-    formatter_->format(msg, formatted);
+    formatter_->format_shared(msg, formatted);
     ::fwrite(formatted.data(), sizeof(char), formatted.size(), file_);
 #endif               // WIN32
     ::fflush(file_); // flush every line to terminal
@@ -51,7 +51,7 @@ protected:
         memory_buf_t formatted;
         if (enable_formatting_)
         {
-            base_sink<Mutex>::formatter_->format(msg, formatted);
+            base_sink<Mutex>::formatter_->format_shared(msg, formatted);
             payload = string_view_t(formatted.data(), formatted.size());
         }
         else
@@ -61,7 +61,29 @@ protected:
     void sink_it_(const spdlog::details::log_msg &msg) override
     {
         spdlog::memory_buf_t formatted;
-        spdlog::sinks::base_sink<Mutex>::formatter_->format(msg, formatted);
+        spdlog::sinks::base_sink<Mutex>::formatter_->format_shared(msg, formatted);
+        if (!client_.is_connected())
+        {
+            client_.connect(config_.server_host, config_.server_port);
+        }
+        client_.send(formatted.data(), formatted.size());
+    }
+
+    // format the whole batch and send it with a single call
+    void sink_batch_(const spdlog::details::log_msg *msgs, size_t count) override
+    {
+        spdlog::memory_buf_t formatted;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (this->should_log(msgs[i].level))
+            {
+                spdlog::sinks::base_sink<Mutex>::formatter_->format_shared(msgs[i], formatted);
+            }
+        }
+        if (formatted.size() == 0)
+        {
+            return;
+        }
         if (!client_.is_connected())
         {
             client_.connect(config_.server_host, config_.server_port);
@@ -49,7 +49,7 @@ protected:
     void sink_it_(const spdlog::details::log_msg &msg) override
     {
         spdlog::memory_buf_t formatted;
-        spdlog::sinks::base_sink<Mutex>::formatter_->format(msg, formatted);
+        spdlog::sinks::base_sink<Mutex>::formatter_->format_shared(msg, formatted);
         client_.send(formatted.data(), formatted.size());
     }
 
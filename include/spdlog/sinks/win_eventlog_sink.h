@@ -233,7 +233,7 @@ protected:
 
         bool succeeded;
         memory_buf_t formatted;
-        base_sink<Mutex>::formatter_->format(msg, formatted);
+        base_sink<Mutex>::formatter_->format_shared(msg, formatted);
         formatted.push_back('\0');
 
 #ifdef SPDLOG_WCHAR_TO_UTF8_SUPPORT
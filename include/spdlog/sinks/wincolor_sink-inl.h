@@ -60,7 +60,7 @@ void SPDLOG_INLINE wincolor_sink<ConsoleMutex>::log(const details::log_msg &msg)
     msg.color_range_start = 0;
     msg.color_range_end = 0;
     memory_buf_t formatted;
-    formatter_->format(msg, formatted);
+    formatter_->format_shared(msg, formatted);
     if (should_do_colors_ && msg.color_range_end > msg.color_range_start)
     {
         // before color range
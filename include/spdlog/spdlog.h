@@ -302,10 +302,26 @@ inline void critical(const T &msg)
 //
 
 #ifndef SPDLOG_NO_SOURCE_LOC
+#    define SPDLOG_CALL_SOURCE_LOC_ spdlog::source_loc{__FILE__, __LINE__, SPDLOG_FUNCTION}
+#else
+#    define SPDLOG_CALL_SOURCE_LOC_ spdlog::source_loc{}
+#endif
+
+// static descriptor of the call site, see details/callsite.h
+#define SPDLOG_CALLSITE_ ([]() -> spdlog::details::callsite & { static spdlog::details::callsite site; return site; }())
+
+#if defined(SPDLOG_COMPILED_FORMAT)
+// the format string (first argument after the level) is compiled with FMT_COMPILE, so it must be a string literal.
+// it is passed on once more along with the arguments, so these are never empty.
+#    define SPDLOG_EXPAND_(x) x
+#    define SPDLOG_FIRST_ARG_(first, ...) first
 #    define SPDLOG_LOGGER_CALL(logger, level, ...)                                                                                         \
-        (logger)->log(spdlog::source_loc{__FILE__, __LINE__, SPDLOG_FUNCTION}, level, __VA_ARGS__)
+        spdlog::details::log_compiled(SPDLOG_CALLSITE_, spdlog::details::callsite_target(logger), SPDLOG_CALL_SOURCE_LOC_, level,          \
+            FMT_COMPILE(SPDLOG_EXPAND_(SPDLOG_FIRST_ARG_(__VA_ARGS__, 0))), __VA_ARGS__)
 #else
-#    define SPDLOG_LOGGER_CALL(logger, level, ...) (logger)->log(spdlog::source_loc{}, level, __VA_ARGS__)
+#    define SPDLOG_LOGGER_CALL(logger, level, ...)                                                                                         \
+        spdlog::details::log_at(                                                                                                           \
+            SPDLOG_CALLSITE_, spdlog::details::callsite_target(logger), SPDLOG_CALL_SOURCE_LOC_, level, __VA_ARGS__)
 #endif
 
 #if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_TRACE
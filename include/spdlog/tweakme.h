@@ -87,6 +87,42 @@
 // #define SPDLOG_USE_STD_FORMAT
 ///////////////////////////////////////////////////////////////////////////////
 
+///////////////////////////////////////////////////////////////////////////////
+// Uncomment to compile the format strings of the SPDLOG_INFO(..),
+// SPDLOG_LOGGER_CALL(..) etc macros with FMT_COMPILE, so they are parsed at
+// compile time. Requires C++17 (before that FMT_COMPILE falls back to a
+// compile time checked format string), and the format string must be a
+// string literal. Not supported with SPDLOG_USE_STD_FORMAT.
+//
+// #define SPDLOG_COMPILED_FORMAT
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Uncomment to use a lock-free bounded queue (instead of a mutex + condition
+// variables) in the async thread pool.
+// Reduces contention when many threads log through the same async logger.
+// Idle consumers spin and yield briefly before parking.
+// The queue size is rounded up to a power of two.
+//
+// #define SPDLOG_ASYNC_LOCKFREE_QUEUE
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Uncomment to change the number of payload bytes stored inline in each async
+// queue slot (default 264). Longer messages use a per slot overflow buffer,
+// which is reused across messages.
+//
+// #define SPDLOG_ASYNC_INLINE_PAYLOAD_SIZE 264
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Uncomment to change the capacity (default 64KiB) up to which the per thread
+// buffer log messages are formatted into is kept for reuse. A buffer grown
+// beyond it by a longer message is freed after that message.
+//
+// #define SPDLOG_SCRATCH_BUFFER_MAX_SIZE (64 * 1024)
+///////////////////////////////////////////////////////////////////////////////
+
 ///////////////////////////////////////////////////////////////////////////////
 // Uncomment to enable wchar_t support (convert to utf8)
 //